@@ -0,0 +1,132 @@
+/*
+  ==============================================================================
+
+    DelayLineBenchmark.h
+    DelayBuffer against juce::dsp::DelayLine doing the same work: two
+    channels, linear interpolation, one write and one read per sample, at
+    host block sizes from 32 to 2048.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "DelayBuffer.h"
+
+#include <iostream>
+
+struct DelayLineTiming
+{
+    double delayBufferNs = 0, delayLineNs = 0;
+    double checksum = 0;
+};
+
+//fixed: one delay for the whole run, DelayBuffer uses its block read. Modulated: a new delay every sample, both
+//read one sample at a time, the way the kernel does while a time is ramping
+inline DelayLineTiming timeDelayLines(int blockSize, bool modulated, double seconds)
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int numChannels = 2;
+    constexpr int maxDelay = 3 * 48000;
+
+    auto numBlocks = juce::jmax(1, (int)(seconds * sampleRate) / blockSize);
+    auto numSamples = (juce::int64)numBlocks * blockSize;
+
+    std::vector<float> input((size_t)blockSize), output((size_t)blockSize), scratch((size_t)blockSize + DelayBufferBase::sincTaps);
+    std::vector<float> delays((size_t)blockSize);
+
+    juce::Random random(1);
+    for (auto& sample : input)
+        sample = random.nextFloat() * 2.f - 1.f;
+
+    auto getDelay = [modulated](juce::int64 n)
+    {
+        return modulated ? 12000.5f + 500.f * std::sin((float)n * .0001f) : 12000.5f;
+    };
+
+    DelayLineTiming timing;
+
+    {
+        DelayBuffer<float> ring;
+        ring.prepare(numChannels, maxDelay);
+
+        auto begin = juce::Time::getHighResolutionTicks();
+
+        for (int b = 0; b < numBlocks; ++b)
+        {
+            for (int i = 0; i < blockSize; ++i)
+                delays[(size_t)i] = getDelay((juce::int64)b * blockSize + i);
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                ring.write(channel, 0, input.data(), blockSize);
+
+                if (modulated) {
+                    for (int i = 0; i < blockSize; ++i)
+                        output[(size_t)i] = ring.read(channel, i, delays[(size_t)i], DelayBufferBase::Interpolation::linear);
+                }
+                else {
+                    ring.read(channel, 0, delays[0], DelayBufferBase::Interpolation::linear, output.data(), blockSize, scratch.data());
+                }
+
+                timing.checksum += output[(size_t)blockSize - 1];
+            }
+
+            ring.advance(blockSize);
+        }
+
+        timing.delayBufferNs = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - begin) * 1.0e9 / (double)(numSamples * numChannels);
+    }
+
+    {
+        juce::dsp::DelayLine<float, juce::dsp::DelayLineInterpolationTypes::Linear> line(maxDelay);
+        line.prepare({ sampleRate, (juce::uint32)blockSize, (juce::uint32)numChannels });
+        line.setDelay(getDelay(0));
+
+        auto begin = juce::Time::getHighResolutionTicks();
+
+        for (int b = 0; b < numBlocks; ++b)
+        {
+            for (int i = 0; i < blockSize; ++i)
+                delays[(size_t)i] = getDelay((juce::int64)b * blockSize + i);
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                for (int i = 0; i < blockSize; ++i)
+                {
+                    line.pushSample(channel, input[(size_t)i]);
+                    output[(size_t)i] = modulated ? line.popSample(channel, delays[(size_t)i]) : line.popSample(channel);
+                }
+
+                timing.checksum += output[(size_t)blockSize - 1];
+            }
+        }
+
+        timing.delayLineNs = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - begin) * 1.0e9 / (double)(numSamples * numChannels);
+    }
+
+    return timing;
+}
+
+inline void runDelayLineBenchmark(double seconds)
+{
+    std::cout << "DelayBuffer vs dsp::DelayLine, 2 channels, linear, ns per sample" << std::endl;
+    std::cout << "   block       mode  DelayBuffer    DelayLine    speedup" << std::endl;
+
+    for (auto modulated : { false, true })
+    {
+        for (int blockSize = 32; blockSize <= 2048; blockSize *= 2)
+        {
+            auto timing = timeDelayLines(blockSize, modulated, seconds);
+
+            std::cout << juce::String(blockSize).paddedLeft(' ', 8)
+                      << juce::String(modulated ? "modulated" : "fixed").paddedLeft(' ', 11)
+                      << juce::String(timing.delayBufferNs, 3).paddedLeft(' ', 13)
+                      << juce::String(timing.delayLineNs, 3).paddedLeft(' ', 13)
+                      << juce::String(timing.delayLineNs / juce::jmax(1.0e-9, timing.delayBufferNs), 2).paddedLeft(' ', 10) << "x"
+                      //printed so neither loop can be optimised away
+                      << "   (" << timing.checksum << ")" << std::endl;
+        }
+    }
+}
@@ -0,0 +1,156 @@
+/*
+  ==============================================================================
+
+    Golden.h
+    Stored reference renders, compared sample for sample with the 32-bit
+    float WAV in Golden/. Most settings render offline, where the ring is
+    sized up front and the interpolation is the windowed sinc. The realtime
+    ones cover the interpolators a user picks and the ring growing on the
+    resize thread, which render() waits for so they are reproducible too.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "Render.h"
+
+//the fixed set of renders the goldens are kept for, short enough to store
+inline std::vector<RenderSettings> getGoldenSettings()
+{
+    std::vector<RenderSettings> settings;
+
+    auto add = [&settings](double sampleRate, int blockSize, int numChannels, Signal signal, Automation automation,
+                           int routing = 0, int oversampling = 0, bool doublePrecision = false) -> RenderSettings&
+    {
+        RenderSettings s;
+        s.sampleRate = sampleRate;
+        s.blockSize = blockSize;
+        s.numChannels = numChannels;
+        s.signal = signal;
+        s.automation = automation;
+        s.routing = routing;
+        s.oversampling = oversampling;
+        s.doublePrecision = doublePrecision;
+        s.offline = true;
+        s.seconds = 2.0;
+        settings.push_back(s);
+        return settings.back();
+    };
+
+    //every routing mode, impulses so the alternation is easy to see
+    for (int routing = 0; routing < 4; ++routing)
+        add(48000.0, 256, 2, Signal::impulses, Automation::none, routing);
+
+    //the rate and block size ends of the matrix, with everything automated
+    add(44100.0, 32, 2, Signal::noise, Automation::sweep);
+    add(96000.0, 512, 2, Signal::sweep, Automation::sweep);
+    add(192000.0, 2048, 2, Signal::noise, Automation::sweep);
+
+    //jumps, oversampling switches and the idle bypass
+    add(48000.0, 128, 2, Signal::noise, Automation::steps);
+    add(48000.0, 256, 2, Signal::noise, Automation::none, 0, 2);
+    add(48000.0, 128, 2, Signal::bursts, Automation::none);
+
+    //the double path, against a golden of its own since it doesn't round the same way as float
+    add(48000.0, 256, 2, Signal::noise, Automation::sweep, 0, 0, true);
+
+    //mono, 5.1 where the centre/LFE pair stays unrouted, and first order ambisonics where nothing is routed
+    add(48000.0, 256, 1, Signal::impulses, Automation::none, 1);
+    add(48000.0, 512, 6, Signal::impulses, Automation::none, 1);
+    add(48000.0, 512, 4, Signal::noise, Automation::sweep, 2);
+
+    //Realtime, with linear, Lagrange and Thiran each. The steps jump the times up to 3 s, past the ring the
+    //starting times size, and the smoothing between them is the ramping read. The sweep keeps both times moving
+    //the whole way, in both precisions.
+    for (int interpolation = 0; interpolation < 3; ++interpolation)
+    {
+        auto& s = add(48000.0, 256, 2, Signal::noise, Automation::steps);
+        s.offline = false;
+        s.interpolation = interpolation;
+    }
+
+    for (auto doublePrecision : { false, true })
+    {
+        auto& s = add(44100.0, 128, 2, Signal::sweep, Automation::sweep, 0, 0, doublePrecision);
+        s.offline = false;
+        s.interpolation = 1;
+    }
+
+    return settings;
+}
+
+inline juce::File getGoldenDirectory()
+{
+    return juce::File(SIMPLEDELAY_GOLDEN_DIR);
+}
+
+inline juce::File getGoldenFile(const RenderSettings& settings)
+{
+    return getGoldenDirectory().getChildFile(settings.getName() + ".wav");
+}
+
+inline bool writeGolden(const juce::File& file, const juce::AudioBuffer<float>& buffer, double sampleRate)
+{
+    file.getParentDirectory().createDirectory();
+    file.deleteFile();
+
+    std::unique_ptr<juce::OutputStream> stream(file.createOutputStream());
+    if (stream == nullptr)
+        return false;
+
+    //32 bit WAV is IEEE float, so the samples round trip exactly
+    std::unique_ptr<juce::AudioFormatWriter> writer(juce::WavAudioFormat().createWriterFor(stream.get(), sampleRate, (unsigned int)buffer.getNumChannels(), 32, {}, 0));
+    if (writer == nullptr)
+        return false;
+
+    stream.release();
+    return writer->writeFromAudioSampleBuffer(buffer, 0, buffer.getNumSamples());
+}
+
+inline bool readGolden(const juce::File& file, juce::AudioBuffer<float>& buffer)
+{
+    std::unique_ptr<juce::AudioFormatReader> reader(juce::WavAudioFormat().createReaderFor(file.createInputStream().release(), true));
+    if (reader == nullptr)
+        return false;
+
+    buffer.setSize((int)reader->numChannels, (int)reader->lengthInSamples);
+    return reader->read(&buffer, 0, buffer.getNumSamples(), 0, true, true);
+}
+
+struct GoldenComparison
+{
+    juce::int64 numDifferent = 0;
+    float maxDifference = 0;
+
+    bool isIdentical() const { return numDifferent == 0; }
+};
+
+inline GoldenComparison compareWithGolden(const juce::AudioBuffer<float>& rendered, const juce::AudioBuffer<float>& golden)
+{
+    GoldenComparison comparison;
+
+    //a different shape is as different as it gets
+    if (rendered.getNumChannels() != golden.getNumChannels() || rendered.getNumSamples() != golden.getNumSamples()) {
+        comparison.numDifferent = (juce::int64)juce::jmax(rendered.getNumChannels(), golden.getNumChannels()) * juce::jmax(rendered.getNumSamples(), golden.getNumSamples());
+        comparison.maxDifference = std::numeric_limits<float>::infinity();
+        return comparison;
+    }
+
+    for (int channel = 0; channel < rendered.getNumChannels(); ++channel)
+    {
+        auto* a = rendered.getReadPointer(channel);
+        auto* b = golden.getReadPointer(channel);
+
+        for (int i = 0; i < rendered.getNumSamples(); ++i)
+        {
+            //bitwise, so a NaN in both still counts as a difference
+            if (std::memcmp(a + i, b + i, sizeof(float)) != 0) {
+                ++comparison.numDifferent;
+                comparison.maxDifference = juce::jmax(comparison.maxDifference, std::abs(a[i] - b[i]));
+            }
+        }
+    }
+
+    return comparison;
+}
@@ -0,0 +1,231 @@
+/*
+  ==============================================================================
+
+    InstanceBenchmark.h
+    N instances of the processor in one process, the way a large session
+    runs them: all on one thread in turn, or split across threads. Reports
+    throughput, memory per instance and, where the platform lets us count
+    them, cache misses.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "Render.h"
+
+#include <initializer_list>
+#include <iostream>
+#include <thread>
+
+#if JUCE_LINUX
+ #include <linux/perf_event.h>
+ #include <sys/ioctl.h>
+ #include <sys/syscall.h>
+#endif
+
+//last level cache references and misses of this process and every thread it starts while counting.
+//Linux perf events only, and only where perf_event_paranoid allows it, isAvailable() says which
+struct CacheCounters
+{
+    CacheCounters()
+    {
+       #if JUCE_LINUX
+        references = open(PERF_COUNT_HW_CACHE_REFERENCES);
+        misses = open(PERF_COUNT_HW_CACHE_MISSES);
+       #endif
+    }
+
+    ~CacheCounters()
+    {
+       #if JUCE_LINUX
+        for (auto fd : { references, misses })
+            if (fd >= 0)
+                close(fd);
+       #endif
+    }
+
+    bool isAvailable() const { return references >= 0 && misses >= 0; }
+
+    void start()
+    {
+       #if JUCE_LINUX
+        for (auto fd : { references, misses })
+        {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+       #endif
+    }
+
+    //the threads have to have been joined, inherited counts are only added back when they exit
+    void stop()
+    {
+       #if JUCE_LINUX
+        for (auto fd : { references, misses })
+            if (fd >= 0)
+                ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+
+        numReferences = read(references);
+        numMisses = read(misses);
+       #endif
+    }
+
+    juce::uint64 numReferences = 0, numMisses = 0;
+
+private:
+    int references = -1, misses = -1;
+
+   #if JUCE_LINUX
+    static int open(juce::uint64 config)
+    {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+
+    static juce::uint64 read(int fd)
+    {
+        juce::uint64 value = 0;
+        if (fd < 0 || ::read(fd, &value, sizeof(value)) != (ssize_t)sizeof(value))
+            return 0;
+        return value;
+    }
+   #endif
+};
+
+struct InstanceRun
+{
+    double wallSeconds = 0;
+    juce::int64 residentBytes = 0;
+    bool countedCache = false;
+    juce::uint64 cacheReferences = 0, cacheMisses = 0;
+};
+
+//renders settings.seconds through numInstances processors. Each thread takes a contiguous slice of the instances
+//and runs them block by block in turn, like a host's audio thread would, with no barrier between the threads,
+//so this is throughput and not latency. Automation is applied per instance on the thread that renders it.
+template <typename SampleType>
+InstanceRun runInstances(const RenderSettings& settings, int numInstances, int numThreads)
+{
+    InstanceRun run;
+
+    //the same input for every instance, generated before the memory baseline
+    auto total = settings.getNumSamples();
+    juce::AudioBuffer<SampleType> input(settings.numChannels, (int)total);
+    SignalGenerator generator(settings);
+    generator.fill(input, 0);
+
+    auto residentBefore = getResidentBytes();
+
+    std::vector<std::unique_ptr<SimpleDelayAudioProcessor>> processors;
+    for (int i = 0; i < numInstances; ++i)
+        processors.push_back(createProcessor(settings));
+
+    auto renderSlice = [&](int first, int last)
+    {
+        juce::AudioBuffer<SampleType> block(settings.numChannels, settings.blockSize);
+        juce::MidiBuffer midi;
+
+        for (juce::int64 start = 0; start < total; start += settings.blockSize)
+        {
+            auto numSamples = (int)juce::jmin((juce::int64)settings.blockSize, total - start);
+            block.setSize(settings.numChannels, numSamples, false, false, true);
+
+            for (int i = first; i < last; ++i)
+            {
+                for (int channel = 0; channel < settings.numChannels; ++channel)
+                    block.copyFrom(channel, 0, input, channel, (int)start, numSamples);
+
+                applyAutomation(*processors[(size_t)i], settings.automation, (double)start / (double)total);
+                processors[(size_t)i]->processBlock(block, midi);
+            }
+        }
+    };
+
+    CacheCounters counters;
+    counters.start();
+    auto begin = juce::Time::getHighResolutionTicks();
+
+    numThreads = juce::jlimit(1, numInstances, numThreads);
+
+    if (numThreads == 1) {
+        renderSlice(0, numInstances);
+    }
+    else {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < numThreads; ++t)
+            threads.emplace_back(renderSlice, numInstances * t / numThreads, numInstances * (t + 1) / numThreads);
+
+        for (auto& thread : threads)
+            thread.join();
+    }
+
+    run.wallSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - begin);
+    counters.stop();
+
+    run.countedCache = counters.isAvailable();
+    run.cacheReferences = counters.numReferences;
+    run.cacheMisses = counters.numMisses;
+    run.residentBytes = getResidentBytes() - residentBefore;
+
+    for (auto& processor : processors)
+        processor->releaseResources();
+
+    return run;
+}
+
+inline void runInstanceBenchmark(const RenderSettings& settings, int maxInstances, int numThreads)
+{
+    std::cout << settings.numChannels << " channels, " << (int)settings.sampleRate << " Hz, blocks of " << settings.blockSize << ", "
+              << settings.seconds << " s, " << (settings.doublePrecision ? "double" : "float") << ", up to " << numThreads << " threads" << std::endl;
+    std::cout << "       N    mode   ns/sample   scaling   instances RT   MB/instance   misses/sample   miss rate" << std::endl;
+
+    auto samplesPerInstance = (double)settings.getNumSamples() * settings.numChannels;
+    auto baseline = 0.0;
+
+    for (int numInstances = 1; numInstances <= maxInstances; numInstances *= 2)
+    {
+        for (auto threaded : { false, true })
+        {
+            //one thread is the serial run already
+            if (threaded && juce::jmin(numInstances, numThreads) < 2)
+                continue;
+
+            auto threads = threaded ? numThreads : 1;
+            auto run = settings.doublePrecision ? runInstances<double>(settings, numInstances, threads)
+                                                : runInstances<float>(settings, numInstances, threads);
+
+            auto samples = samplesPerInstance * numInstances;
+            auto ns = run.wallSeconds * 1.0e9 / samples;
+
+            if (baseline == 0.0)
+                baseline = ns;
+
+            std::cout << juce::String(numInstances).paddedLeft(' ', 8)
+                      << juce::String(threaded ? "pool" : "serial").paddedLeft(' ', 8)
+                      << juce::String(ns, 2).paddedLeft(' ', 12)
+                      //how much faster per sample than one instance alone, ideally the number of threads in use
+                      << juce::String(baseline / ns, 2).paddedLeft(' ', 10)
+                      << juce::String(settings.seconds * numInstances / run.wallSeconds, 1).paddedLeft(' ', 15)
+                      << juce::String((double)run.residentBytes / numInstances / (1024.0 * 1024.0), 3).paddedLeft(' ', 14);
+
+            if (run.countedCache)
+                std::cout << juce::String((double)run.cacheMisses / samples, 3).paddedLeft(' ', 16)
+                          << juce::String(100.0 * (double)run.cacheMisses / (double)juce::jmax((juce::uint64)1, run.cacheReferences), 1).paddedLeft(' ', 11) << "%";
+            else
+                std::cout << juce::String("n/a").paddedLeft(' ', 16) << juce::String("n/a").paddedLeft(' ', 12);
+
+            std::cout << std::endl;
+        }
+    }
+}
@@ -0,0 +1,175 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+    SimpleDelayBenchmark: runs SimpleDelayAudioProcessor without a host or an
+    editor, so the performance and bit-exactness claims can be rerun.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "Render.h"
+#include "Golden.h"
+#include "DelayLineBenchmark.h"
+#include "StateBenchmark.h"
+#include "SaturatorBenchmark.h"
+#include "InstanceBenchmark.h"
+
+#include <iostream>
+
+static double getDoubleOption(const juce::ArgumentList& args, juce::StringRef option, double defaultValue)
+{
+    auto value = args.getValueForOption(option);
+    return value.isEmpty() ? defaultValue : value.getDoubleValue();
+}
+
+static int getIntOption(const juce::ArgumentList& args, juce::StringRef option, int defaultValue)
+{
+    auto value = args.getValueForOption(option);
+    return value.isEmpty() ? defaultValue : value.getIntValue();
+}
+
+//sample rates x block sizes, realtime, noise with everything automated
+static void runRenderMatrix(const juce::ArgumentList& args)
+{
+    RenderSettings settings;
+    settings.seconds = getDoubleOption(args, "--seconds", 10.0);
+    settings.numChannels = getIntOption(args, "--channels", 2);
+    settings.routing = getIntOption(args, "--routing", 0);
+    settings.oversampling = getIntOption(args, "--oversampling", 0);
+    settings.doublePrecision = args.containsOption("--double");
+    settings.offline = args.containsOption("--offline");
+
+    std::cout << settings.numChannels << " channels, " << settings.seconds << " s per render, "
+              << (settings.doublePrecision ? "double" : "float") << (settings.offline ? ", offline" : "") << std::endl;
+    std::cout << "    rate   block   ns/sample   realtime x   memory MB" << std::endl;
+
+    for (auto sampleRate : { 44100.0, 48000.0, 88200.0, 96000.0, 176400.0, 192000.0 })
+    {
+        for (auto blockSize : { 32, 64, 128, 256, 512, 1024, 2048 })
+        {
+            settings.sampleRate = sampleRate;
+            settings.blockSize = blockSize;
+
+            auto result = render(settings, false);
+
+            std::cout << juce::String((int)sampleRate).paddedLeft(' ', 8)
+                      << juce::String(blockSize).paddedLeft(' ', 8)
+                      << juce::String(result.getNanosecondsPerSample(), 2).paddedLeft(' ', 12)
+                      << juce::String(result.getRealtimeFactor(sampleRate), 1).paddedLeft(' ', 13)
+                      << juce::String((double)result.residentBytes / (1024.0 * 1024.0), 2).paddedLeft(' ', 12) << std::endl;
+        }
+    }
+}
+
+//renders every golden setting and compares it with the stored file, or stores it when recording
+static void runGolden(bool record)
+{
+    auto failures = 0;
+
+    for (auto& settings : getGoldenSettings())
+    {
+        auto result = render(settings, true);
+        auto file = getGoldenFile(settings);
+
+        if (record) {
+            if (! writeGolden(file, result.output, settings.sampleRate))
+                juce::ConsoleApplication::fail("couldn't write " + file.getFullPathName());
+
+            std::cout << "recorded  " << settings.getName() << std::endl;
+            continue;
+        }
+
+        juce::AudioBuffer<float> golden;
+        if (! readGolden(file, golden)) {
+            std::cout << "MISSING   " << settings.getName() << " (run record on a build whose output is known good)" << std::endl;
+            ++failures;
+            continue;
+        }
+
+        auto comparison = compareWithGolden(result.output, golden);
+
+        if (comparison.isIdentical()) {
+            std::cout << "identical " << settings.getName() << std::endl;
+        }
+        else {
+            std::cout << "DIFFERENT " << settings.getName() << ": " << comparison.numDifferent << " samples, max "
+                      << comparison.maxDifference << std::endl;
+            ++failures;
+        }
+    }
+
+    if (failures > 0)
+        juce::ConsoleApplication::fail(juce::String(failures) + " golden renders don't match");
+}
+
+int main(int argc, char* argv[])
+{
+    //the processor's parameters and async updates expect a message manager, this thread is the message thread
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::ConsoleApplication app;
+    app.addHelpCommand("--help|-h", "SimpleDelayBenchmark", true);
+
+    app.addCommand({ "render",
+                     "render [--seconds=10] [--channels=2] [--routing=0] [--oversampling=0] [--double] [--offline]",
+                     "Times the processor over every sample rate and block size",
+                     "Renders noise with every continuous parameter automated, at 44.1 to 192 kHz and blocks of 32 to 2048,\n"
+                     "and prints ns per channel sample, the real-time factor and the memory the instance added.",
+                     [](const juce::ArgumentList& args) { runRenderMatrix(args); } });
+
+    app.addCommand({ "golden",
+                     "golden",
+                     "Compares renders with the stored golden renders",
+                     "Every setting in getGoldenSettings() is rendered and compared bit for bit with Golden/.\n"
+                     "Exits with an error if any of them differ or are missing.",
+                     [](const juce::ArgumentList&) { runGolden(false); } });
+
+    app.addCommand({ "record",
+                     "record",
+                     "Stores the golden renders",
+                     "Renders every golden setting and overwrites Golden/ with the result. Only for changes that\n"
+                     "are meant to alter the output.",
+                     [](const juce::ArgumentList&) { runGolden(true); } });
+
+    app.addCommand({ "delayline",
+                     "delayline [--seconds=10]",
+                     "DelayBuffer against juce::dsp::DelayLine",
+                     "Two channels of linear interpolation at block sizes 32 to 2048, with a fixed and a modulated delay.",
+                     [](const juce::ArgumentList& args) { runDelayLineBenchmark(getDoubleOption(args, "--seconds", 10.0)); } });
+
+    app.addCommand({ "state",
+                     "state [--iterations=10000]",
+                     "Binary state against ValueTree state",
+                     "Save and load time of both formats, and whether each restores every parameter.",
+                     [](const juce::ArgumentList& args) { runStateBenchmark(getIntOption(args, "--iterations", 10000)); } });
+
+    app.addCommand({ "saturator",
+                     "saturator [--seconds=10]",
+                     "Error and speed of every Saturator quality",
+                     "Exact, High and Fast in float and double: the worst error against std::tanh in double over [-20, 20]\n"
+                     "and the input it is at, and ns per sample over 512 sample blocks of noise in [-4, 4].",
+                     [](const juce::ArgumentList& args) { runSaturatorBenchmark(getDoubleOption(args, "--seconds", 10.0)); } });
+
+    app.addCommand({ "instances",
+                     "instances [--max=256] [--threads=<cpus>] [--seconds=5] [--rate=48000] [--block=512] [--channels=2] [--double]",
+                     "N instances serially and on a thread pool",
+                     "Doubles N up to --max and renders N instances on one thread in turn, then split across --threads.\n"
+                     "Prints ns per channel sample, scaling against one instance, how many instances run in real time,\n"
+                     "resident memory per instance and, on Linux with perf events allowed, last level cache misses.",
+                     [](const juce::ArgumentList& args)
+                     {
+                         RenderSettings settings;
+                         settings.seconds = getDoubleOption(args, "--seconds", 5.0);
+                         settings.sampleRate = getDoubleOption(args, "--rate", 48000.0);
+                         settings.blockSize = getIntOption(args, "--block", 512);
+                         settings.numChannels = getIntOption(args, "--channels", 2);
+                         settings.doublePrecision = args.containsOption("--double");
+
+                         runInstanceBenchmark(settings, getIntOption(args, "--max", 256),
+                                              getIntOption(args, "--threads", juce::SystemStats::getNumCpus()));
+                     } });
+
+    return app.findAndRunCommand(argc, argv);
+}
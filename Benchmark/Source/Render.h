@@ -0,0 +1,334 @@
+/*
+  ==============================================================================
+
+    Render.h
+    Drives SimpleDelayAudioProcessor the way a host does, with no editor and
+    no message loop: synthetic input, automation applied between blocks, and
+    the time spent inside processBlock.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+
+#include <fstream>
+
+#if JUCE_LINUX
+ #include <unistd.h>
+#elif JUCE_MAC
+ #include <mach/mach.h>
+#elif JUCE_WINDOWS
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #include <windows.h>
+ #include <psapi.h>
+ #pragma comment(lib, "psapi.lib")
+#endif
+
+//current resident set of the process in bytes, 0 where the platform isn't handled
+inline juce::int64 getResidentBytes()
+{
+   #if JUCE_LINUX
+    std::ifstream statm("/proc/self/statm");
+    long long size = 0, resident = 0;
+    statm >> size >> resident;
+    return (juce::int64)resident * (juce::int64)sysconf(_SC_PAGESIZE);
+   #elif JUCE_MAC
+    mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS)
+        return 0;
+    return (juce::int64)info.resident_size;
+   #elif JUCE_WINDOWS
+    PROCESS_MEMORY_COUNTERS counters;
+    if (! GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return (juce::int64)counters.WorkingSetSize;
+   #else
+    return 0;
+   #endif
+}
+
+//what goes into the plugin. Every generator is a function of the absolute sample index (noise is consumed in
+//order), so the input doesn't depend on the block size
+enum class Signal { impulses, sweep, noise, bursts };
+
+//how the parameters move over the render, applied once per host block
+enum class Automation { none, sweep, steps };
+
+struct RenderSettings
+{
+    double sampleRate = 48000.0;
+    int blockSize = 512;
+    int numChannels = 2;
+    bool doublePrecision = false;
+    bool offline = false;
+    double seconds = 10.0;
+    Signal signal = Signal::noise;
+    Automation automation = Automation::sweep;
+    int routing = 0;
+    int oversampling = 0;
+
+    //linear, Lagrange or Thiran. Offline renders always use the windowed sinc, so it only counts in realtime
+    int interpolation = 0;
+
+    //stereo, 5.1 and first order ambisonics get their real channel sets, anything else is discrete
+    juce::AudioChannelSet getChannelSet() const
+    {
+        switch (numChannels)
+        {
+            case 1: return juce::AudioChannelSet::mono();
+            case 2: return juce::AudioChannelSet::stereo();
+            case 4: return juce::AudioChannelSet::ambisonic(1);
+            case 6: return juce::AudioChannelSet::create5point1();
+            default: return juce::AudioChannelSet::discreteChannels(numChannels);
+        }
+    }
+
+    juce::int64 getNumSamples() const { return (juce::int64)(seconds * sampleRate); }
+
+    //also the golden file name, so every setting that changes the output has to be in here
+    juce::String getName() const
+    {
+        static const char* signalNames[] = { "impulses", "sweep", "noise", "bursts" };
+        static const char* automationNames[] = { "static", "sweep", "steps" };
+
+        return juce::String(signalNames[(int)signal]) + "_" + automationNames[(int)automation]
+             + "_" + juce::String((int)sampleRate) + "_b" + juce::String(blockSize) + "_" + juce::String(numChannels) + "ch"
+             + "_r" + juce::String(routing) + "_os" + juce::String(oversampling)
+             + (doublePrecision ? "_double" : "_float") + (offline ? "_offline" : "_i" + juce::String(interpolation));
+    }
+};
+
+inline void setParameter(SimpleDelayAudioProcessor& processor, const char* id, float value)
+{
+    auto* param = processor.apvts.getParameter(id);
+    jassert(param != nullptr);
+    param->setValueNotifyingHost(param->convertTo0to1(value));
+}
+
+//position runs from 0 at the start of the render to 1 at the end
+inline void applyAutomation(SimpleDelayAudioProcessor& processor, Automation automation, double position)
+{
+    auto pos = (float)position;
+
+    switch (automation)
+    {
+        case Automation::sweep:
+        {
+            //every continuous parameter moving at once, the times in opposite directions
+            setParameter(processor, "freqLeft", 10.f + 990.f * pos);
+            setParameter(processor, "freqRight", 1000.f - 900.f * pos);
+            setParameter(processor, "feedback", .5f + .45f * std::sin(juce::MathConstants<float>::twoPi * 3.f * pos));
+            setParameter(processor, "dryWet", pos);
+            setParameter(processor, "lowCut", 20.f + 480.f * pos);
+            setParameter(processor, "highCut", 20000.f - 15000.f * pos);
+            setParameter(processor, "tilt", -6.f + 12.f * pos);
+            break;
+        }
+
+        case Automation::steps:
+        {
+            //jumps every eighth of the render, so the smoothing and the oversampling switch are exercised
+            static const float times[] = { 250.f, 40.f, 1200.f, 5.f, 700.f, 3000.f, 90.f, 333.f };
+            static const float feedbacks[] = { .5f, .9f, .2f, 1.f, .0f, .7f, .95f, .4f };
+            auto step = juce::jlimit(0, 7, (int)(pos * 8));
+
+            setParameter(processor, "freqLeft", times[step]);
+            setParameter(processor, "freqRight", times[7 - step]);
+            setParameter(processor, "feedback", feedbacks[step]);
+            setParameter(processor, "dryWet", step % 2 == 0 ? .5f : .8f);
+            setParameter(processor, "wetAlgo", step >= 4 ? 1.f : 0.f);
+            setParameter(processor, "oversampling", (float)(step % 3));
+            break;
+        }
+
+        case Automation::none:
+        default:
+        {
+            setParameter(processor, "freqLeft", 250.f);
+            setParameter(processor, "freqRight", 375.f);
+            setParameter(processor, "feedback", .6f);
+            setParameter(processor, "dryWet", .5f);
+            break;
+        }
+    }
+}
+
+struct SignalGenerator
+{
+    explicit SignalGenerator(const RenderSettings& s) : settings(s)
+    {
+        for (int channel = 0; channel < settings.numChannels; ++channel)
+            random.emplace_back(1 + channel);
+    }
+
+    template <typename SampleType>
+    void fill(juce::AudioBuffer<SampleType>& block, juce::int64 start)
+    {
+        auto sampleRate = settings.sampleRate;
+        auto period = (juce::int64)(sampleRate / 2);
+        auto length = (double)juce::jmax((juce::int64)1, settings.getNumSamples());
+
+        for (int channel = 0; channel < block.getNumChannels(); ++channel)
+        {
+            auto* data = block.getWritePointer(channel);
+            auto& rng = random[(size_t)channel];
+
+            for (int i = 0; i < block.getNumSamples(); ++i)
+            {
+                auto n = start + i;
+                double value = 0;
+
+                switch (settings.signal)
+                {
+                    case Signal::impulses:
+                        value = n % period == 0 ? 1.0 : 0.0;
+                        break;
+
+                    case Signal::sweep:
+                    {
+                        //exponential sweep 20 Hz to 20 kHz over the whole render
+                        auto t = (double)n / sampleRate;
+                        auto duration = length / sampleRate;
+                        auto k = std::log(20000.0 / 20.0);
+                        auto phase = juce::MathConstants<double>::twoPi * 20.0 * duration / k * (std::exp(t / duration * k) - 1.0);
+                        value = .5 * std::sin(phase + channel * juce::MathConstants<double>::halfPi);
+                        break;
+                    }
+
+                    case Signal::bursts:
+                    {
+                        //100 ms of noise every 2.5 s, long enough in between for the processor to go to sleep
+                        auto noise = rng.nextDouble() * 2.0 - 1.0;
+                        value = n % (juce::int64)(sampleRate * 2.5) < (juce::int64)(sampleRate * .1) ? .25 * noise : 0.0;
+                        break;
+                    }
+
+                    case Signal::noise:
+                    default:
+                        value = .25 * (rng.nextDouble() * 2.0 - 1.0);
+                        break;
+                }
+
+                data[i] = (SampleType)value;
+            }
+        }
+    }
+
+    const RenderSettings& settings;
+    std::vector<juce::Random> random;
+};
+
+//a processor set up for settings, prepared the way a host would
+inline std::unique_ptr<SimpleDelayAudioProcessor> createProcessor(const RenderSettings& settings)
+{
+    auto processor = std::make_unique<SimpleDelayAudioProcessor>();
+
+    juce::AudioProcessor::BusesLayout layout;
+    layout.inputBuses.add(settings.getChannelSet());
+    layout.outputBuses.add(settings.getChannelSet());
+
+    if (! processor->setBusesLayout(layout))
+        juce::ConsoleApplication::fail("layout not supported: " + settings.getChannelSet().getDescription());
+
+    processor->setProcessingPrecision(settings.doublePrecision ? juce::AudioProcessor::doublePrecision : juce::AudioProcessor::singlePrecision);
+    processor->setNonRealtime(settings.offline);
+    processor->setRateAndBufferSizeDetails(settings.sampleRate, settings.blockSize);
+
+    setParameter(*processor, "link", 0.f);
+    setParameter(*processor, "routing", (float)settings.routing);
+    setParameter(*processor, "oversampling", (float)settings.oversampling);
+    setParameter(*processor, "interpolation", (float)settings.interpolation);
+    applyAutomation(*processor, settings.automation, 0.0);
+
+    processor->prepareToPlay(settings.sampleRate, settings.blockSize);
+    return processor;
+}
+
+struct RenderResult
+{
+    //only filled when the render was captured, always float because that is what the goldens are stored as
+    juce::AudioBuffer<float> output;
+
+    double processSeconds = 0;
+    juce::int64 numSamples = 0;
+    int numChannels = 0;
+    juce::int64 residentBytes = 0;
+
+    //per sample of one channel
+    double getNanosecondsPerSample() const { return processSeconds * 1.0e9 / (double)juce::jmax((juce::int64)1, numSamples * numChannels); }
+
+    //seconds of audio per second spent in processBlock
+    double getRealtimeFactor(double sampleRate) const { return (double)numSamples / sampleRate / juce::jmax(1.0e-12, processSeconds); }
+};
+
+//Renders settings.seconds of the synthetic input, timing only the processBlock calls. A captured realtime render
+//waits between blocks for the resize thread whenever the ring has to grow, so the bigger ring always comes in at
+//the next block and the output doesn't depend on how the threads are scheduled.
+template <typename SampleType>
+RenderResult render(const RenderSettings& settings, bool capture)
+{
+    RenderResult result;
+    auto residentBefore = getResidentBytes();
+
+    auto processor = createProcessor(settings);
+
+    //and a ring that grew isn't given back partway through, however slowly the render runs
+    if (capture)
+        processor->setDelayMemoryReleaseTime(1.0e6);
+
+    SignalGenerator generator(settings);
+
+    auto total = settings.getNumSamples();
+    result.numSamples = total;
+    result.numChannels = settings.numChannels;
+
+    if (capture)
+        result.output.setSize(settings.numChannels, (int)total);
+
+    juce::AudioBuffer<SampleType> block(settings.numChannels, settings.blockSize);
+    juce::MidiBuffer midi;
+    juce::int64 ticks = 0;
+
+    for (juce::int64 start = 0; start < total; start += settings.blockSize)
+    {
+        auto numSamples = (int)juce::jmin((juce::int64)settings.blockSize, total - start);
+        block.setSize(settings.numChannels, numSamples, false, false, true);
+
+        generator.fill(block, start);
+        applyAutomation(*processor, settings.automation, (double)start / (double)total);
+
+        auto begin = juce::Time::getHighResolutionTicks();
+        processor->processBlock(block, midi);
+        ticks += juce::Time::getHighResolutionTicks() - begin;
+
+        if (capture) {
+            while (processor->isDelayMemoryGrowing())
+                juce::Thread::sleep(1);
+
+            for (int channel = 0; channel < settings.numChannels; ++channel)
+            {
+                auto* src = block.getReadPointer(channel);
+                auto* dest = result.output.getWritePointer(channel, (int)start);
+                for (int i = 0; i < numSamples; ++i)
+                    dest[i] = (float)src[i];
+            }
+        }
+    }
+
+    result.processSeconds = juce::Time::highResolutionTicksToSeconds(ticks);
+    result.residentBytes = getResidentBytes() - residentBefore - (capture ? (juce::int64)result.output.getNumChannels() * total * (juce::int64)sizeof(float) : 0);
+
+    processor->releaseResources();
+    return result;
+}
+
+inline RenderResult render(const RenderSettings& settings, bool capture)
+{
+    return settings.doublePrecision ? render<double>(settings, capture) : render<float>(settings, capture);
+}
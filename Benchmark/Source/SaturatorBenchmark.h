@@ -0,0 +1,106 @@
+/*
+  ==============================================================================
+
+    SaturatorBenchmark.h
+    Every Saturator quality in both precisions: the worst error against
+    std::tanh in double over [-20, 20], and the time process() takes per
+    sample over 512 sample blocks.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "Saturator.h"
+
+#include <iomanip>
+#include <iostream>
+
+struct SaturatorMeasurement
+{
+    double maxError = 0, worstInput = 0;
+    double ns = 0;
+    double checksum = 0;
+};
+
+template <typename SampleType>
+SaturatorMeasurement measureSaturator(Saturator::Quality quality, double seconds)
+{
+    constexpr int blockSize = 512;
+    constexpr juce::int64 numSteps = 4000000;
+
+    Saturator saturator;
+    saturator.setQuality(quality);
+
+    std::vector<SampleType> input((size_t)blockSize), block((size_t)blockSize);
+    SaturatorMeasurement measurement;
+
+    //every 1e-5 from -20 to 20, through process() so the vector path and its scalar tail are what's measured
+    for (juce::int64 start = 0; start <= numSteps; start += blockSize)
+    {
+        auto numSamples = (int)juce::jmin((juce::int64)blockSize, numSteps + 1 - start);
+
+        for (int i = 0; i < numSamples; ++i)
+            input[(size_t)i] = block[(size_t)i] = (SampleType)(-20.0 + 40.0 * (double)(start + i) / (double)numSteps);
+
+        saturator.process(block.data(), numSamples);
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            auto error = std::abs((double)block[(size_t)i] - std::tanh((double)input[(size_t)i]));
+
+            if (error > measurement.maxError) {
+                measurement.maxError = error;
+                measurement.worstInput = (double)input[(size_t)i];
+            }
+        }
+    }
+
+    //noise over [-4, 4] reaches the knee and both clamps, only the process() calls are timed
+    juce::Random random(1);
+    for (auto& sample : input)
+        sample = (SampleType)(random.nextDouble() * 8.0 - 4.0);
+
+    auto numBlocks = juce::jmax(1, (int)(seconds * 48000.0) / blockSize);
+    juce::int64 ticks = 0;
+
+    for (int b = 0; b < numBlocks; ++b)
+    {
+        std::copy(input.begin(), input.end(), block.begin());
+
+        auto begin = juce::Time::getHighResolutionTicks();
+        saturator.process(block.data(), blockSize);
+        ticks += juce::Time::getHighResolutionTicks() - begin;
+
+        measurement.checksum += (double)block[(size_t)(b % blockSize)];
+    }
+
+    measurement.ns = juce::Time::highResolutionTicksToSeconds(ticks) * 1.0e9 / ((double)numBlocks * blockSize);
+    return measurement;
+}
+
+inline void runSaturatorBenchmark(double seconds)
+{
+    static const char* qualityNames[] = { "Exact", "High", "Fast" };
+
+    std::cout << "Saturator against std::tanh in double over [-20, 20], ns per sample over 512 sample blocks of [-4, 4]" << std::endl;
+    std::cout << " quality  precision    max error     at input   ns/sample" << std::endl;
+
+    for (auto quality : { Saturator::Quality::exact, Saturator::Quality::high, Saturator::Quality::fast })
+    {
+        for (auto doublePrecision : { false, true })
+        {
+            auto measurement = doublePrecision ? measureSaturator<double>(quality, seconds)
+                                               : measureSaturator<float>(quality, seconds);
+
+            std::cout << juce::String(qualityNames[(int)quality]).paddedLeft(' ', 8)
+                      << juce::String(doublePrecision ? "double" : "float").paddedLeft(' ', 11)
+                      << std::setw(13) << std::scientific << std::setprecision(2) << measurement.maxError << std::defaultfloat << std::setprecision(6)
+                      << juce::String(measurement.worstInput, 5).paddedLeft(' ', 13)
+                      << juce::String(measurement.ns, 3).paddedLeft(' ', 12)
+                      //printed so the timed loop can't be optimised away
+                      << "   (" << measurement.checksum << ")" << std::endl;
+        }
+    }
+}
@@ -0,0 +1,79 @@
+/*
+  ==============================================================================
+
+    StateBenchmark.h
+    Save and load times of the binary state against the ValueTree state it
+    replaced, which setStateInformation still reads.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "Render.h"
+
+#include <iostream>
+
+inline void runStateBenchmark(int iterations)
+{
+    SimpleDelayAudioProcessor processor;
+
+    //every parameter off its default so nothing is saved or restored by accident
+    juce::Random random(1);
+    for (auto* param : processor.getParameters())
+        param->setValueNotifyingHost(random.nextFloat());
+
+    std::vector<float> saved;
+    for (auto* param : processor.getParameters())
+        saved.push_back(param->getValue());
+
+    juce::MemoryBlock binary;
+    processor.getStateInformation(binary);
+
+    //what getStateInformation wrote before the binary format
+    juce::MemoryBlock tree;
+    {
+        juce::MemoryOutputStream stream(tree, false);
+        processor.apvts.copyState().writeToStream(stream);
+    }
+
+    auto restores = [&]
+    {
+        auto params = processor.getParameters();
+        for (int i = 0; i < params.size(); ++i)
+            if (params[i]->getValue() != saved[(size_t)i])
+                return false;
+        return true;
+    };
+
+    auto timeLoads = [&](const juce::MemoryBlock& state)
+    {
+        auto begin = juce::Time::getHighResolutionTicks();
+        for (int i = 0; i < iterations; ++i)
+            processor.setStateInformation(state.getData(), (int)state.getSize());
+        return juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - begin) * 1.0e6 / iterations;
+    };
+
+    auto timeSaves = [&](auto&& save)
+    {
+        auto begin = juce::Time::getHighResolutionTicks();
+        for (int i = 0; i < iterations; ++i)
+            save();
+        return juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - begin) * 1.0e6 / iterations;
+    };
+
+    auto binaryLoad = timeLoads(binary);
+    auto binaryRestores = restores();
+    auto treeLoad = timeLoads(tree);
+    auto treeRestores = restores();
+
+    auto binarySave = timeSaves([&] { juce::MemoryBlock block; processor.getStateInformation(block); });
+    auto treeSave = timeSaves([&] { juce::MemoryBlock block; juce::MemoryOutputStream stream(block, false); processor.apvts.copyState().writeToStream(stream); });
+
+    std::cout << "state, " << iterations << " iterations, us per call" << std::endl;
+    std::cout << "              bytes       load       save   restores" << std::endl;
+    std::cout << "   binary" << juce::String((int)binary.getSize()).paddedLeft(' ', 10) << juce::String(binaryLoad, 2).paddedLeft(' ', 11)
+              << juce::String(binarySave, 2).paddedLeft(' ', 11) << juce::String(binaryRestores ? "yes" : "NO").paddedLeft(' ', 11) << std::endl;
+    std::cout << "valuetree" << juce::String((int)tree.getSize()).paddedLeft(' ', 10) << juce::String(treeLoad, 2).paddedLeft(' ', 11)
+              << juce::String(treeSave, 2).paddedLeft(' ', 11) << juce::String(treeRestores ? "yes" : "NO").paddedLeft(' ', 11) << std::endl;
+}
@@ -0,0 +1,613 @@
+/*
+  ==============================================================================
+
+    DelayBuffer.h
+
+    Multichannel ring buffer for the delay kernel.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    Planar ring buffer with a power-of-two capacity, so wrapping is a mask
+    instead of a modulo. All channels live in one allocation and share a
+    single write position, which the processor advances once per block
+    after every channel has been processed.
+
+    Positions passed to read() and write() are offsets from the start of
+    the current block. A delay of d at offset i reads the sample written d
+    samples before it, using one of four interpolators:
+
+        Linear        2 taps, the same maths as juce::dsp::DelayLine<..., Linear>
+        Lagrange3rd   4 taps, as DelayLine<..., Lagrange3rd>
+        Thiran        first order allpass, as DelayLine<..., Thiran>. Flat
+                      magnitude but recursive, so it clicks if the delay jumps
+        WindowedSinc  16 taps of a Blackman windowed sinc, from a table of 256
+                      fractional phases. Meant for offline rendering
+
+    Lagrange, Thiran and the sinc read samples newer than the integer part of
+    the delay (see getLookahead()), which a caller writing in blocks has to
+    keep its runs clear of.
+
+    Runs of reads have block versions. At a fixed delay the coefficients are
+    the same for the whole run, so each tap is one vector multiply-add over
+    a span of the ring. With a delay per sample, Lagrange computes its
+    coefficients as rows for the whole run and only gathers the taps per
+    sample. The other three read one sample at a time whenever the delay
+    moves: linear is cheaper that way, Thiran is recursive, and the sinc's
+    per-sample coefficient blend is already a vector op.
+
+    The ring can be resized while the audio thread is running. requestResize()
+    allocates the new ring on another thread and copies the audio across
+    while the audio thread keeps writing to the old one, catching up in
+    passes. applyResize() on the audio thread then only copies what was
+    written since the last pass and swaps the new ring in, and
+    releaseRetired() frees the old one back on the other thread. The audio
+    thread never allocates, frees or waits, and copies a couple of blocks
+    per channel at most, whatever the size of the ring.
+*/
+struct DelayBufferBase
+{
+    //shared by every sample type, so a mode picked once works with both the float and the double buffer
+    enum class Interpolation { linear, lagrange3rd, thiran, windowedSinc };
+
+    static constexpr int sincTaps = 16;
+    static constexpr int sincPhases = 256;
+
+    //how many samples newer than the integer part of the delay the interpolator reads
+    static int getLookahead(Interpolation interpolation)
+    {
+        switch (interpolation)
+        {
+            case Interpolation::lagrange3rd:
+            case Interpolation::thiran:       return 1;
+            case Interpolation::windowedSinc: return sincTaps / 2 - 1;
+            case Interpolation::linear:
+            default:                          return 0;
+        }
+    }
+};
+
+template <typename SampleType>
+class DelayBuffer : public DelayBufferBase
+{
+public:
+
+    //two contiguous pieces of one channel, the second is empty unless the range wraps
+    struct Span
+    {
+        const SampleType* first = nullptr;
+        int firstSize = 0;
+        const SampleType* second = nullptr;
+        int secondSize = 0;
+    };
+
+    //While the audio thread isn't running. maximumBlockSize is the most the caller writes between advance() calls,
+    //which a resize needs to know to stay clear of the writes; 0 if the ring is never resized.
+    void prepare(int newNumChannels, int maximumDelayInSamples, int maximumBlockSize = 0)
+    {
+        numChannels = newNumChannels;
+        copyGuard = 2 * maximumBlockSize + sincTaps;
+        capacity = getCapacityFor(maximumDelayInSamples);
+        maxDelay = getMaximumDelayFor(capacity);
+        mask = capacity - 1;
+
+        storage.allocate((size_t)(numChannels * capacity), true);
+        thiranState.allocate((size_t)numChannels, true);
+        pending.free();
+        resizeState.store(idle, std::memory_order_relaxed);
+        written.store(0, std::memory_order_relaxed);
+        writePos = 0;
+
+        //builds the shared table here rather than on the audio thread
+        getSincTable();
+    }
+
+    //audio thread, the write position carries on so a resize in flight can tell its copy is out of date
+    void reset()
+    {
+        storage.clear((size_t)(numChannels * capacity));
+        resetInterpolation();
+        resets.fetch_add(1, std::memory_order_release);
+    }
+
+    //the Thiran allpass keeps one sample of state per channel, clear it when switching to it
+    void resetInterpolation() { thiranState.clear((size_t)numChannels); }
+
+    int getNumChannels() const { return numChannels; }
+
+    //the longest delay the current ring can hold, at least what it was prepared or resized for.
+    //Off the audio thread, only valid while no resize is in flight (requestResize() would return true)
+    int getMaximumDelayInSamples() const { return maxDelay; }
+    int getCapacity() const { return capacity; }
+
+    //room behind the longest delay for the oldest sinc tap
+    static int getCapacityFor(int maximumDelayInSamples) { return juce::nextPowerOfTwo(maximumDelayInSamples + sincTaps / 2 + 1); }
+    static int getMaximumDelayFor(int ringCapacity) { return ringCapacity - sincTaps / 2 - 1; }
+
+    //Any thread but the audio thread, or the audio thread itself when it can afford to (offline). Allocates a ring
+    //for the new maximum delay and copies the newest audio into it for applyResize() to pick up.
+    //Returns false if the last resize hasn't been applied yet.
+    bool requestResize(int maximumDelayInSamples)
+    {
+        if (! releaseRetired())
+            return false;
+
+        pendingCapacity = getCapacityFor(maximumDelayInSamples);
+        pending.allocate((size_t)(numChannels * pendingCapacity), true);
+
+        //Everything written before a snapshot of the write position is final. The oldest copyGuard samples of the
+        //old ring are left to applyResize(), they are the ones the audio thread overwrites next, and the copy
+        //goes in chunks that each skip ahead of what it has overwritten since. Each pass after the first only
+        //copies what was written during the one before, so they get shorter until it's caught up.
+        auto guard = juce::jmin(copyGuard, capacity);
+        auto keep = (juce::int64)juce::jmin(capacity - guard, pendingCapacity);
+
+        pendingResets = resets.load(std::memory_order_acquire);
+        auto first = written.load(std::memory_order_acquire) - keep;
+        auto from = first;
+        pendingCopiedFrom = first;
+
+        for (int pass = 0; pass < maxCopyPasses; ++pass)
+        {
+            auto to = written.load(std::memory_order_acquire);
+
+            while (from < to)
+            {
+                auto oldest = written.load(std::memory_order_acquire) - keep;
+
+                if (from < oldest)
+                    from = pendingCopiedFrom = juce::jmin(oldest, to);
+
+                auto end = juce::jmin(to, from + copyChunk);
+                copyToPending(from, end);
+                from = end;
+            }
+
+            pendingWritten = to;
+
+            if (written.load(std::memory_order_acquire) - to <= guard)
+                break;
+        }
+
+        //A chunk read while the audio thread overtook it may hold newer samples than it should, but only ones that
+        //are older than the newest keep samples by now. Everything older than those is silenced and left to
+        //applyResize(), which fills in what of it the new ring keeps.
+        auto overtaken = written.load(std::memory_order_acquire) - keep;
+        pendingCopiedFrom = juce::jlimit(pendingCopiedFrom, pendingWritten, juce::jmax(pendingWritten - keep, overtaken));
+        copyToPending(juce::jmax(first, pendingWritten - pendingCapacity), pendingCopiedFrom, true);
+
+        resizeState.store(ready, std::memory_order_release);
+        return true;
+    }
+
+    //Audio thread, before any channel of the block is read or written. Swaps in a ring from requestResize() with as
+    //much of the newest audio as fits in it, so repeats carry on across a grow and the recent ones survive a shrink.
+    void applyResize()
+    {
+        if (resizeState.load(std::memory_order_acquire) != ready)
+            return;
+
+        auto now = written.load(std::memory_order_relaxed);
+        auto sinceCopy = now - pendingWritten;
+
+        //cleared after the copy started, or the copy fell too far behind: the other thread starts again
+        if (resets.load(std::memory_order_relaxed) != pendingResets || sinceCopy > 2 * (juce::int64)juce::jmax(copyGuard, 1)) {
+            resizeState.store(stale, std::memory_order_release);
+            return;
+        }
+
+        //The new ring holds exactly the newest keep samples: what the copy has that is older goes, the oldest ones it
+        //left out and what was written since the last pass come in. Each of them is a couple of blocks at most.
+        auto keep = (juce::int64)juce::jmin(capacity, pendingCapacity);
+
+        copyToPending(pendingCopiedFrom, now - keep, true);
+        copyToPending(now - keep, pendingCopiedFrom);
+        copyToPending(pendingWritten, now);
+
+        storage.swapWith(pending);
+        std::swap(capacity, pendingCapacity);
+        maxDelay = getMaximumDelayFor(capacity);
+        mask = capacity - 1;
+        writePos = (int)(now & mask);
+
+        resizeState.store(retired, std::memory_order_release);
+    }
+
+    //Same thread as requestResize(). Frees the ring applyResize() swapped out, or the one it turned down,
+    //true once nothing is in flight.
+    bool releaseRetired()
+    {
+        auto state = resizeState.load(std::memory_order_acquire);
+
+        if (state == retired || state == stale) {
+            pending.free();
+            resizeState.store(idle, std::memory_order_relaxed);
+            return true;
+        }
+
+        return state == idle;
+    }
+
+    //any thread, true while a ring from requestResize() is waiting for applyResize()
+    bool isResizeReady() const { return resizeState.load(std::memory_order_acquire) == ready; }
+
+    SampleType read(int channel, int offset, SampleType delay, Interpolation interpolation)
+    {
+        jassert(juce::isPositiveAndNotGreaterThan(delay, (SampleType)maxDelay));
+
+        auto delayInt = (int)delay;
+        auto delayFrac = delay - (SampleType)delayInt;
+
+        auto* data = getChannel(channel);
+        auto at = [&](int d) { return data[(writePos + offset - d) & mask]; };
+
+        switch (interpolation)
+        {
+            case Interpolation::lagrange3rd:
+            {
+                //centres the four taps around the read position
+                if (delayInt >= 1) {
+                    delayFrac++;
+                    delayInt--;
+                }
+
+                SampleType c[4];
+                lagrangeCoefficients(delayFrac, c);
+                return c[0] * at(delayInt) + c[1] * at(delayInt + 1) + c[2] * at(delayInt + 2) + c[3] * at(delayInt + 3);
+            }
+
+            case Interpolation::thiran:
+            {
+                //keeps the fraction in the range where the allpass is well behaved
+                if (delayFrac < (SampleType)0.618 && delayInt >= 1) {
+                    delayFrac++;
+                    delayInt--;
+                }
+
+                auto alpha = (1 - delayFrac) / (1 + delayFrac);
+                return thiran(channel, at(delayInt), at(delayInt + 1), delayFrac, alpha);
+            }
+
+            case Interpolation::windowedSinc:
+            {
+                SampleType c[sincTaps];
+                sincCoefficients(delayFrac, c);
+
+                SampleType out = 0;
+                for (int k = 0; k < sincTaps; k++)
+                    out += c[k] * at(delayInt - (sincTaps / 2 - 1) + k);
+                return out;
+            }
+
+            case Interpolation::linear:
+            default:
+            {
+                auto value1 = at(delayInt);
+                auto value2 = at(delayInt + 1);
+                return value1 + delayFrac * (value2 - value1);
+            }
+        }
+    }
+
+    //numSamples consecutive reads at a fixed delay. The coefficients are the same for every sample, so the FIR
+    //interpolators become one vector multiply-add per tap over a span of the ring. scratch must hold
+    //numSamples + sincTaps samples and is only written when the span wraps.
+    void read(int channel, int offset, SampleType delay, Interpolation interpolation, SampleType* dest, int numSamples, SampleType* scratch)
+    {
+        using FVO = juce::FloatVectorOperations;
+        jassert(juce::isPositiveAndNotGreaterThan(delay, (SampleType)maxDelay));
+
+        auto delayInt = (int)delay;
+        auto delayFrac = delay - (SampleType)delayInt;
+
+        //oldest..newest samples the run needs, copied out only if they wrap
+        auto getTaps = [&](int oldest, int size)
+        {
+            auto span = getSpan(channel, offset, oldest, size);
+            if (span.secondSize == 0)
+                return span.first;
+
+            std::copy_n(span.first, span.firstSize, scratch);
+            std::copy_n(span.second, span.secondSize, scratch + span.firstSize);
+            return (const SampleType*)scratch;
+        };
+
+        switch (interpolation)
+        {
+            case Interpolation::lagrange3rd:
+            {
+                if (delayInt >= 1) {
+                    delayFrac++;
+                    delayInt--;
+                }
+
+                SampleType c[4];
+                lagrangeCoefficients(delayFrac, c);
+
+                //taps[i + 3] is the newest tap of sample i and taps[i] the oldest
+                auto* taps = getTaps(delayInt + 3, numSamples + 3);
+                FVO::copyWithMultiply(dest, taps + 3, c[0], numSamples);
+                FVO::addWithMultiply(dest, taps + 2, c[1], numSamples);
+                FVO::addWithMultiply(dest, taps + 1, c[2], numSamples);
+                FVO::addWithMultiply(dest, taps, c[3], numSamples);
+                break;
+            }
+
+            case Interpolation::thiran:
+            {
+                //recursive, so this stays a scalar loop, but alpha is only computed once
+                if (delayFrac < (SampleType)0.618 && delayInt >= 1) {
+                    delayFrac++;
+                    delayInt--;
+                }
+
+                auto alpha = (1 - delayFrac) / (1 + delayFrac);
+                auto* taps = getTaps(delayInt + 1, numSamples + 1);
+
+                for (int i = 0; i < numSamples; i++)
+                    dest[i] = thiran(channel, taps[i + 1], taps[i], delayFrac, alpha);
+                break;
+            }
+
+            case Interpolation::windowedSinc:
+            {
+                SampleType c[sincTaps];
+                sincCoefficients(delayFrac, c);
+
+                //tap k of sample i is taps[i + sincTaps - 1 - k]
+                auto* taps = getTaps(delayInt + sincTaps / 2, numSamples + sincTaps - 1);
+                FVO::copyWithMultiply(dest, taps + sincTaps - 1, c[0], numSamples);
+                for (int k = 1; k < sincTaps; k++)
+                    FVO::addWithMultiply(dest, taps + sincTaps - 1 - k, c[k], numSamples);
+                break;
+            }
+
+            case Interpolation::linear:
+            default:
+            {
+                //taps[i] is the older tap of sample i and taps[i + 1] the newer one, same maths as the scalar read
+                auto* taps = getTaps(delayInt + 1, numSamples + 1);
+                FVO::subtract(dest, taps, taps + 1, numSamples);
+                FVO::multiply(dest, delayFrac, numSamples);
+                FVO::add(dest, taps + 1, numSamples);
+                break;
+            }
+        }
+    }
+
+    //numSamples consecutive reads with a delay of their own each, for a ramping or modulated time. Lagrange is
+    //split into rows: each sample's integer position and fraction first, then the four coefficient rows and the
+    //multiply-adds over the whole run, so only gathering the taps from the ring is left per sample. Linear is
+    //cheaper as a gather per sample than as rows, Thiran is recursive, and the sinc already blends its 16
+    //coefficients as one vector op per sample, so those go through the scalar read. The same maths as the
+    //scalar read either way, sample for sample.
+    void read(int channel, int offset, const SampleType* delays, Interpolation interpolation, SampleType* dest, int numSamples)
+    {
+        if (interpolation != Interpolation::lagrange3rd) {
+            for (int i = 0; i < numSamples; i++)
+                dest[i] = read(channel, offset + i, delays[i], interpolation);
+            return;
+        }
+
+        using FVO = juce::FloatVectorOperations;
+        auto* data = getChannel(channel);
+
+        for (int done = 0; done < numSamples; done += rampChunk)
+        {
+            auto n = juce::jmin(rampChunk, numSamples - done);
+            auto* out = dest + done;
+
+            //position of the newest tap of each read and how far past it the read is, centred like the scalar read
+            int newest[rampChunk];
+            SampleType frac[rampChunk];
+
+            for (int i = 0; i < n; i++)
+            {
+                auto delay = delays[done + i];
+                jassert(juce::isPositiveAndNotGreaterThan(delay, (SampleType)maxDelay));
+
+                auto delayInt = (int)delay;
+                frac[i] = delay - (SampleType)delayInt;
+
+                if (delayInt >= 1) {
+                    frac[i]++;
+                    delayInt--;
+                }
+
+                newest[i] = writePos + offset + done + i - delayInt;
+            }
+
+            //the four coefficient rows
+            SampleType c[4][rampChunk];
+
+            for (int i = 0; i < n; i++)
+            {
+                auto d1 = frac[i] - 1;
+                auto d2 = frac[i] - 2;
+                auto d3 = frac[i] - 3;
+
+                c[0][i] = -d1 * d2 * d3 / 6;
+                c[1][i] = frac[i] * d2 * d3 / 2;
+                c[2][i] = -frac[i] * d1 * d3 / 2;
+                c[3][i] = frac[i] * d1 * d2 / 6;
+            }
+
+            //one multiply-add per tap over the run, in the scalar read's order
+            SampleType taps[rampChunk];
+
+            for (int k = 0; k < 4; k++)
+            {
+                for (int i = 0; i < n; i++)
+                    taps[i] = data[(newest[i] - k) & mask];
+
+                if (k == 0)
+                    FVO::multiply(out, c[0], taps, n);
+                else
+                    FVO::addWithMultiply(out, c[k], taps, n);
+            }
+        }
+    }
+
+    //numSamples samples of one channel starting `delay` samples behind block offset `offset`
+    Span getSpan(int channel, int offset, int delay, int numSamples) const
+    {
+        jassert(numSamples <= capacity);
+
+        auto* data = getChannel(channel);
+        auto start = (writePos + offset - delay) & mask;
+        auto firstSize = juce::jmin(numSamples, capacity - start);
+
+        return { data + start, firstSize, data, numSamples - firstSize };
+    }
+
+    void write(int channel, int offset, const SampleType* source, int numSamples)
+    {
+        jassert(numSamples <= capacity);
+
+        auto* data = getChannel(channel);
+        auto start = (writePos + offset) & mask;
+        auto firstSize = juce::jmin(numSamples, capacity - start);
+
+        std::copy_n(source, firstSize, data + start);
+        std::copy_n(source + firstSize, numSamples - firstSize, data);
+    }
+
+    //called once per block, after every channel has been written
+    void advance(int numSamples)
+    {
+        auto position = written.load(std::memory_order_relaxed) + numSamples;
+        written.store(position, std::memory_order_release);
+        writePos = (int)(position & mask);
+    }
+
+private:
+    //tap k sits k + 1 - sincTaps / 2 samples older than the integer delay, phase p is a fraction of p / sincPhases
+    using SincTable = std::array<std::array<SampleType, sincTaps>, sincPhases + 1>;
+
+    static const SincTable& getSincTable()
+    {
+        static const SincTable table = []
+        {
+            SincTable t{};
+            constexpr auto half = sincTaps / 2;
+
+            for (int p = 0; p <= sincPhases; p++)
+            {
+                auto frac = (double)p / sincPhases;
+                double sum = 0;
+
+                for (int k = 0; k < sincTaps; k++)
+                {
+                    //distance of the tap from the exact read position
+                    auto x = (double)(k + 1 - half) - frac;
+                    auto sinc = x == 0 ? 1.0 : std::sin(juce::MathConstants<double>::pi * x) / (juce::MathConstants<double>::pi * x);
+                    auto w = juce::MathConstants<double>::pi * x / half;
+                    auto window = .42 + .5 * std::cos(w) + .08 * std::cos(2 * w);
+
+                    t[(size_t)p][(size_t)k] = (SampleType)(sinc * window);
+                    sum += sinc * window;
+                }
+
+                //unity gain at DC for every phase
+                for (auto& c : t[(size_t)p])
+                    c = (SampleType)(c / sum);
+            }
+
+            return t;
+        }();
+
+        return table;
+    }
+
+    //linear between the two nearest phases of the table
+    static void sincCoefficients(SampleType frac, SampleType* c)
+    {
+        auto& table = getSincTable();
+        auto pos = frac * (SampleType)sincPhases;
+        auto phase = juce::jmin((int)pos, sincPhases - 1);
+        auto blend = pos - (SampleType)phase;
+
+        auto& lo = table[(size_t)phase];
+        auto& hi = table[(size_t)phase + 1];
+
+        for (int k = 0; k < sincTaps; k++)
+            c[k] = lo[(size_t)k] + blend * (hi[(size_t)k] - lo[(size_t)k]);
+    }
+
+    //weights of the taps from newest to oldest, frac is in [0, 2)
+    static void lagrangeCoefficients(SampleType frac, SampleType* c)
+    {
+        auto d1 = frac - 1;
+        auto d2 = frac - 2;
+        auto d3 = frac - 3;
+
+        c[0] = -d1 * d2 * d3 / 6;
+        c[1] = frac * d2 * d3 / 2;
+        c[2] = -frac * d1 * d3 / 2;
+        c[3] = frac * d1 * d2 / 6;
+    }
+
+    SampleType thiran(int channel, SampleType value1, SampleType value2, SampleType delayFrac, SampleType alpha)
+    {
+        auto& state = thiranState[channel];
+        auto output = delayFrac == 0 ? value1 : value2 + alpha * (value1 - state);
+        state = output;
+        return output;
+    }
+
+    SampleType* getChannel(int channel) { return storage.get() + (size_t)channel * (size_t)capacity; }
+    const SampleType* getChannel(int channel) const { return storage.get() + (size_t)channel * (size_t)capacity; }
+
+    //copies the samples written at absolute positions [from, to) from the ring to the same positions in pending,
+    //or silences those positions in pending
+    void copyToPending(juce::int64 from, juce::int64 to, bool silence = false)
+    {
+        //nothing was written before 0, and pending starts out silent
+        from = juce::jmax(from, (juce::int64)0);
+
+        for (int channel = 0; channel < numChannels; channel++)
+        {
+            auto* src = getChannel(channel);
+            auto* dest = pending.get() + (size_t)channel * (size_t)pendingCapacity;
+
+            for (auto position = from; position < to;)
+            {
+                auto srcIndex = (int)(position & mask);
+                auto destIndex = (int)(position & (pendingCapacity - 1));
+                auto count = (int)juce::jmin(to - position, (juce::int64)(capacity - srcIndex), (juce::int64)(pendingCapacity - destIndex));
+
+                if (silence)
+                    std::fill_n(dest + destIndex, count, (SampleType)0);
+                else
+                    std::copy_n(src + srcIndex, count, dest + destIndex);
+                position += count;
+            }
+        }
+    }
+
+    juce::HeapBlock<SampleType> storage, thiranState;
+    int numChannels = 0, maxDelay = 0, capacity = 0, mask = 0;
+    int writePos = 0;
+
+    //samples written since prepare(), writePos is this masked. Read by the resizing thread
+    std::atomic<juce::int64> written{ 0 };
+    std::atomic<int> resets{ 0 };
+
+    //idle: nothing in flight. ready: pending is the new ring. retired: pending is the old ring, waiting to be freed.
+    //stale: applyResize() turned pending down, waiting to be freed
+    enum ResizeState { idle, ready, retired, stale };
+    static constexpr int maxCopyPasses = 8, copyChunk = 1024;
+
+    //reads of a ramping delay are done this many at a time, in rows on the stack
+    static constexpr int rampChunk = 64;
+    std::atomic<int> resizeState{ idle };
+    juce::HeapBlock<SampleType> pending;
+    int pendingCapacity = 0, copyGuard = 0, pendingResets = 0;
+    juce::int64 pendingWritten = 0, pendingCopiedFrom = 0;
+};
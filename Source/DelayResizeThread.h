@@ -0,0 +1,87 @@
+/*
+  ==============================================================================
+
+    DelayResizeThread.h
+
+    The background thread that grows and shrinks the delay rings.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    One thread for every instance in the process, held through a
+    juce::SharedResourcePointer, that does the allocating and copying of a
+    ring resize so neither the audio thread nor the message thread has to.
+    Being a thread of its own, a headless or offline host that never runs a
+    message loop still gets its rings resized.
+
+    An audio thread that reaches past its ring only sets a flag with
+    requestGrowth(), a relaxed atomic store: it never takes a lock or makes
+    a system call for it. The thread checks that flag every
+    growthPollIntervalMs and looks at every client when it is set, and
+    otherwise every shrinkPollIntervalMs, which is all a shrink after
+    seconds of short times needs.
+*/
+class DelayResizeThread : public juce::Thread
+{
+public:
+    struct Client
+    {
+        virtual ~Client() = default;
+
+        //on the resize thread, for one client at a time
+        virtual void resizeDelayBuffers() = 0;
+    };
+
+    static constexpr int growthPollIntervalMs = 5, shrinkPollIntervalMs = 250;
+
+    DelayResizeThread() : juce::Thread("SimpleDelay ring resize") { startThread(); }
+    ~DelayResizeThread() override { stopThread(1000); }
+
+    void addClient(Client* client)
+    {
+        const juce::ScopedLock sl(lock);
+        clients.addIfNotAlreadyThere(client);
+    }
+
+    //returns once the client isn't being called, and it won't be again
+    void removeClient(Client* client)
+    {
+        const juce::ScopedLock sl(lock);
+        clients.removeFirstMatchingValue(client);
+    }
+
+    //audio thread, a client's ring is too short for the times it has been asked for
+    void requestGrowth() { growthWanted.store(true, std::memory_order_relaxed); }
+
+    void run() override
+    {
+        auto lastVisit = juce::Time::getMillisecondCounter();
+
+        while (!threadShouldExit())
+        {
+            wait(growthPollIntervalMs);
+
+            auto now = juce::Time::getMillisecondCounter();
+
+            if (!growthWanted.exchange(false, std::memory_order_relaxed) && now - lastVisit < (juce::uint32)shrinkPollIntervalMs)
+                continue;
+
+            lastVisit = now;
+
+            const juce::ScopedLock sl(lock);
+            for (auto* client : clients)
+                client->resizeDelayBuffers();
+        }
+    }
+
+private:
+    juce::CriticalSection lock;
+    juce::Array<Client*> clients;
+    std::atomic<bool> growthWanted{ false };
+};
@@ -13,10 +13,16 @@
 SimpleDelayAudioProcessorEditor::SimpleDelayAudioProcessorEditor(SimpleDelayAudioProcessor& p)
     : AudioProcessorEditor(&p), audioProcessor(p), freqLeftAT(audioProcessor.apvts, "freqLeft", freqLeft),
     freqRightAT(audioProcessor.apvts, "freqRight", freqRight), feedbackAT(audioProcessor.apvts, "feedback", feedback), 
-    dryWetAT(audioProcessor.apvts, "dryWet", dryWet), linkAT(audioProcessor.apvts, "link", link), 
-    wetAlgoAT(audioProcessor.apvts, "wetAlgo", wetAlgo)
+    dryWetAT(audioProcessor.apvts, "dryWet", dryWet), lowCutAT(audioProcessor.apvts, "lowCut", lowCut),
+    highCutAT(audioProcessor.apvts, "highCut", highCut), tiltAT(audioProcessor.apvts, "tilt", tilt),
+    linkAT(audioProcessor.apvts, "link", link), wetAlgoAT(audioProcessor.apvts, "wetAlgo", wetAlgo),
+    syncAT(audioProcessor.apvts, "sync", sync)
 {
     setLookAndFeel(&laf);
+    setOpaque(true);
+
+    logo = juce::ImageCache::getFromMemory(BinaryData::KITIK_LOGO_NO_BKGD_png, BinaryData::KITIK_LOGO_NO_BKGD_pngSize);
+    titleFont = juce::Font(juce::Typeface::createSystemTypefaceFor(BinaryData::OFFSHORE_TTF, BinaryData::OFFSHORE_TTFSize)).withHeight(30.f);
     
     addAndMakeVisible(meterL);
     addAndMakeVisible(meterR);
@@ -43,6 +49,60 @@ SimpleDelayAudioProcessorEditor::SimpleDelayAudioProcessorEditor(SimpleDelayAudi
     dryWet.setName("Dry/Wet");
     addAndMakeVisible(dryWet);
 
+    //feedback tone, the suffix makes the knob label show the parameter's own text
+    lowCut.setSliderStyle(juce::Slider::RotaryHorizontalVerticalDrag);
+    lowCut.setTextBoxStyle(juce::Slider::NoTextBox, false, 100, 20);
+    lowCut.setTextValueSuffix(" Hz");
+    lowCut.setName("Low Cut");
+    addAndMakeVisible(lowCut);
+
+    highCut.setSliderStyle(juce::Slider::RotaryHorizontalVerticalDrag);
+    highCut.setTextBoxStyle(juce::Slider::NoTextBox, false, 100, 20);
+    highCut.setTextValueSuffix(" Hz");
+    highCut.setName("High Cut");
+    addAndMakeVisible(highCut);
+
+    tilt.setSliderStyle(juce::Slider::RotaryHorizontalVerticalDrag);
+    tilt.setTextBoxStyle(juce::Slider::NoTextBox, false, 100, 20);
+    tilt.setTextValueSuffix(" dB");
+    tilt.setName("Tilt");
+    addAndMakeVisible(tilt);
+
+    //the boxes list the parameter's own choices, so they can't drift from the layout
+    auto makeChoiceBox = [this](juce::ComboBox& box, const char* parameterID, const juce::String& tooltip)
+    {
+        auto* choice = dynamic_cast<juce::AudioParameterChoice*>(audioProcessor.apvts.getParameter(parameterID));
+        jassert(choice != nullptr);
+
+        box.addItemList(choice->choices, 1);
+        box.setTooltip(tooltip);
+        addAndMakeVisible(box);
+
+        return std::make_unique<juce::AudioProcessorValueTreeState::ComboBoxAttachment>(audioProcessor.apvts, parameterID, box);
+    };
+
+    divisionLeftAT = makeChoiceBox(divisionLeft, "divisionLeft", "Left delay time while synced to the host tempo");
+    divisionRightAT = makeChoiceBox(divisionRight, "divisionRight", "Right delay time while synced to the host tempo");
+    routingAT = makeChoiceBox(routing, "routing", "How the left and right delays feed each other");
+    oversamplingAT = makeChoiceBox(oversampling, "oversampling", "Oversampling of the saturation in the feedback path");
+
+    routingLabel.setText("Routing", juce::dontSendNotification);
+    routingLabel.setJustificationType(juce::Justification::centred);
+    addAndMakeVisible(routingLabel);
+
+    oversamplingLabel.setText("Oversampling", juce::dontSendNotification);
+    oversamplingLabel.setJustificationType(juce::Justification::centred);
+    addAndMakeVisible(oversamplingLabel);
+
+    sync.setButtonText("SYNC");
+    sync.setTooltip("Delay times follow the host tempo in the note divisions below");
+    addAndMakeVisible(sync);
+
+    //the attachments fire these for automation as well as clicks
+    sync.onClick = [this]() { updateSyncDisplay(); };
+    divisionLeft.onChange = [this]() { updateSyncDisplay(); };
+    divisionRight.onChange = [this]() { updateSyncDisplay(); };
+
     link.setToggleState(true, juce::dontSendNotification);
     link.setButtonText("LINK");
     addAndMakeVisible(link);
@@ -86,88 +146,59 @@ SimpleDelayAudioProcessorEditor::SimpleDelayAudioProcessorEditor(SimpleDelayAudi
         if (link.getToggleState()) {
             freqRight.setValue(freqLeft.getValue());
         }
+        updateSyncDisplay();
     };
 
-    startTimerHz(24);
+    updateSyncDisplay();
+
+   #if SIMPLEDELAY_OPENGL_EDITOR
+    openGLContext.attachTo(*this);
+   #endif
 
-    setSize (600, 450);
+    setSize (600, 560);
 }
 
 SimpleDelayAudioProcessorEditor::~SimpleDelayAudioProcessorEditor()
 {
+   #if SIMPLEDELAY_OPENGL_EDITOR
+    openGLContext.detach();
+   #endif
+
     setLookAndFeel(nullptr);
 }
 
 //==============================================================================
 void SimpleDelayAudioProcessorEditor::paint (juce::Graphics& g)
 {
-    //Time to relearn flexbox....
-    auto bounds = getLocalBounds();
-    auto grad = juce::ColourGradient::ColourGradient(juce::Colour(186u, 34u, 34u), bounds.toFloat().getTopRight(), juce::Colour(186u, 34u, 34u), bounds.toFloat().getBottomLeft(), false);
-    grad.addColour(.5f, juce::Colours::black);
-    g.setGradientFill(grad);
-
-    g.fillAll ();
-
-    auto inputMeter = bounds.removeFromLeft(bounds.getWidth() * .167);
-    auto meterLSide = inputMeter.removeFromLeft(inputMeter.getWidth() * .5);
-    meterL.setBounds(meterLSide);
-    meterR.setBounds(inputMeter);
-
-    auto outputMeter = bounds.removeFromRight(bounds.getWidth() * .2);
-    auto outMeterLSide = outputMeter.removeFromLeft(outputMeter.getWidth() * .5);
-    outMeterL.setBounds(outMeterLSide);
-    outMeterR.setBounds(outputMeter);
-
-    auto infoSpace = bounds.removeFromTop(bounds.getHeight() * .15);
-    auto logoSpace = infoSpace.removeFromLeft(bounds.getWidth() * .41);
-    auto textSpace = infoSpace.removeFromRight(bounds.getWidth() * .41);
-
-    auto freqLeftBounds = bounds.removeFromLeft(bounds.getWidth() * .4);
-    freqLeftBounds = freqLeftBounds.removeFromTop(bounds.getHeight() * .5);
-    freqLeft.setBounds(freqLeftBounds);
-
-    auto freqRightBounds = bounds.removeFromRight(bounds.getWidth() * .66);
-    freqRightBounds = freqRightBounds.removeFromTop(bounds.getHeight() * .5);
-    freqRight.setBounds(freqRightBounds);
-
-    auto linkBounds = bounds.removeFromRight(bounds.getWidth());
-    linkBounds = linkBounds.removeFromTop(bounds.getHeight() * .33);
-    linkBounds = linkBounds.removeFromBottom(bounds.getHeight() * .2);
-    link.setBounds(linkBounds);
-
-    bounds = getLocalBounds();
-    bounds.removeFromLeft(bounds.getWidth() * .167);
-    bounds.removeFromRight(bounds.getWidth() * .2);
-    bounds.removeFromTop(bounds.getHeight() * .15);
+    //everything static is pre-rendered in resized(), the meters and controls paint themselves
+    g.drawImage(background, getLocalBounds().toFloat());
+}
 
-    auto feedbackBounds = bounds.removeFromLeft(bounds.getWidth() * .4);
-    feedbackBounds = feedbackBounds.removeFromBottom(bounds.getHeight() * .5);
-    feedback.setBounds(feedbackBounds);
+void SimpleDelayAudioProcessorEditor::renderBackground()
+{
+    auto scale = juce::Component::getApproximateScaleFactorForComponent(this);
+    background = juce::Image(juce::Image::RGB, juce::jmax(1, juce::roundToInt(getWidth() * scale)), juce::jmax(1, juce::roundToInt(getHeight() * scale)), false);
 
-    auto dryWetBounds = bounds.removeFromRight(bounds.getWidth() * .66);
-    dryWetBounds = dryWetBounds.removeFromBottom(bounds.getHeight() * .5);
-    dryWet.setBounds(dryWetBounds);
+    juce::Graphics g(background);
+    g.addTransform(juce::AffineTransform::scale(scale));
 
-    auto wetAlgoBounds = bounds.removeFromRight(bounds.getWidth());
-    wetAlgoBounds = wetAlgoBounds.removeFromBottom(bounds.getHeight() * .35);
-    wetAlgoBounds = wetAlgoBounds.removeFromTop(bounds.getHeight() * .15);
-    wetAlgo.setBounds(wetAlgoBounds);
+    auto bounds = getLocalBounds().toFloat();
+    auto grad = juce::ColourGradient(juce::Colour(186u, 34u, 34u), bounds.getTopRight(), juce::Colour(186u, 34u, 34u), bounds.getBottomLeft(), false);
+    grad.addColour(.5f, juce::Colours::black);
+    g.setGradientFill(grad);
+    g.fillAll();
 
-    auto logo = juce::ImageCache::getFromMemory(BinaryData::KITIK_LOGO_NO_BKGD_png, BinaryData::KITIK_LOGO_NO_BKGD_pngSize);
-    g.drawImage(logo, infoSpace.toFloat());
+    g.drawImage(logo, logoBounds.toFloat());
 
-    auto newFont = juce::Font(juce::Typeface::createSystemTypefaceFor(BinaryData::OFFSHORE_TTF, BinaryData::OFFSHORE_TTFSize));
     g.setColour(juce::Colours::whitesmoke);
-    g.setFont(newFont);
-    g.setFont(30.f);
-    g.drawFittedText("Simple", logoSpace, juce::Justification::centredRight, 1);
-    g.drawFittedText("Delay", textSpace, juce::Justification::centredLeft, 1);
+    g.setFont(titleFont);
+    g.drawFittedText("Simple", titleLeftBounds, juce::Justification::centredRight, 1);
+    g.drawFittedText("Delay", titleRightBounds, juce::Justification::centredLeft, 1);
 }
 
 void SimpleDelayAudioProcessorEditor::resized()
 {
-
+    //Time to relearn flexbox....
     auto bounds = getLocalBounds();
 
     auto inputMeter = bounds.removeFromLeft(bounds.getWidth() * .167);
@@ -181,8 +212,12 @@ void SimpleDelayAudioProcessorEditor::resized()
     outMeterR.setBounds(outputMeter);
 
     auto infoSpace = bounds.removeFromTop(bounds.getHeight() * .15);
-    auto logoSpace = infoSpace.removeFromLeft(bounds.getWidth() * .425);
-    auto textSpace = infoSpace.removeFromRight(bounds.getWidth() * .425);
+    titleLeftBounds = infoSpace.removeFromLeft(bounds.getWidth() * .41);
+    titleRightBounds = infoSpace.removeFromRight(bounds.getWidth() * .41);
+    logoBounds = infoSpace;
+
+    //sync, tone and routing along the bottom, the main knobs keep their layout above it
+    auto controlStrip = bounds.removeFromBottom(controlStripHeight);
 
     auto freqLeftBounds = bounds.removeFromLeft(bounds.getWidth() * .4);
     freqLeftBounds = freqLeftBounds.removeFromTop(bounds.getHeight() * .5);
@@ -201,6 +236,7 @@ void SimpleDelayAudioProcessorEditor::resized()
     bounds.removeFromLeft(bounds.getWidth() * .167);
     bounds.removeFromRight(bounds.getWidth() * .2);
     bounds.removeFromTop(bounds.getHeight() * .15);
+    bounds.removeFromBottom(controlStripHeight);
     
     auto feedbackBounds = bounds.removeFromLeft(bounds.getWidth() * .4);
     feedbackBounds = feedbackBounds.removeFromBottom(bounds.getHeight() * .5);
@@ -215,20 +251,81 @@ void SimpleDelayAudioProcessorEditor::resized()
     wetAlgoBounds = wetAlgoBounds.removeFromTop(bounds.getHeight() * .15);
     wetAlgo.setBounds(wetAlgoBounds);
 
+    auto syncColumn = controlStrip.removeFromLeft(controlStrip.getWidth() / 4).reduced(4, 2);
+    auto rowHeight = syncColumn.getHeight() / 3;
+    sync.setBounds(syncColumn.removeFromTop(rowHeight));
+    divisionLeft.setBounds(syncColumn.removeFromTop(rowHeight).reduced(0, 4));
+    divisionRight.setBounds(syncColumn.reduced(0, 4));
+
+    auto choiceColumn = controlStrip.removeFromRight(controlStrip.getWidth() / 3).reduced(4, 2);
+    rowHeight = choiceColumn.getHeight() / 4;
+    routingLabel.setBounds(choiceColumn.removeFromTop(rowHeight));
+    routing.setBounds(choiceColumn.removeFromTop(rowHeight).reduced(0, 2));
+    oversamplingLabel.setBounds(choiceColumn.removeFromTop(rowHeight));
+    oversampling.setBounds(choiceColumn.reduced(0, 2));
+
+    auto knobWidth = controlStrip.getWidth() / 3;
+    lowCut.setBounds(controlStrip.removeFromLeft(knobWidth));
+    highCut.setBounds(controlStrip.removeFromLeft(knobWidth));
+    tilt.setBounds(controlStrip);
+
+    renderBackground();
 }
 
-void SimpleDelayAudioProcessorEditor::timerCallback()
+void SimpleDelayAudioProcessorEditor::updateSyncDisplay()
 {
-    //these get our rms level, and the set level function tells you how much of the rect you want
-    meterL.setLevel(audioProcessor.getRMSValue(0));
-    meterR.setLevel(audioProcessor.getRMSValue(1));
+    auto synced = sync.getToggleState();
+    auto linked = link.getToggleState();
 
-    meterL.repaint();
-    meterR.repaint();
+    //the knobs do nothing while synced, so they are greyed out and show the division the processor is using
+    freqLeft.setEnabled(! synced);
+    freqRight.setEnabled(! synced);
+    divisionLeft.setEnabled(synced);
+    divisionRight.setEnabled(synced && ! linked);
 
-    outMeterL.setLevel(audioProcessor.getOutRMSValue(0));
-    outMeterR.setLevel(audioProcessor.getOutRMSValue(1));
+    freqLeft.getProperties().set(Laf::syncedTextId, synced ? divisionLeft.getText() : juce::String());
+    freqRight.getProperties().set(Laf::syncedTextId, synced ? (linked ? divisionLeft : divisionRight).getText() : juce::String());
 
-    outMeterL.repaint();
-    outMeterR.repaint();
+    freqLeft.repaint();
+    freqRight.repaint();
+}
+
+void SimpleDelayAudioProcessorEditor::updateMeters()
+{
+    //drain every block's meter frame since the last refresh and integrate them, so the meters don't depend on the host block size
+    auto numFrames = audioProcessor.popMeterFrames(meterFrames.data(), (int)meterFrames.size());
+
+    SimpleDelayAudioProcessor::MeterFrame total;
+    for (int i = 0; i < numFrames; ++i)
+    {
+        auto& frame = meterFrames[(size_t)i];
+        for (size_t channel = 0; channel < 2; ++channel)
+        {
+            total.inSquares[channel] += frame.inSquares[channel];
+            total.outSquares[channel] += frame.outSquares[channel];
+            total.inPeak[channel] = juce::jmax(total.inPeak[channel], frame.inPeak[channel]);
+            total.outPeak[channel] = juce::jmax(total.outPeak[channel], frame.outPeak[channel]);
+        }
+        total.numSamples += frame.numSamples;
+    }
+
+    //refreshes with no new audio (display faster than the host block rate) just let the ballistics run
+    if (total.numSamples > 0) {
+        //floored at -60 so the meters are empty rather than negative when nothing is playing
+        auto rmsDecibels = [&total](float squares) { return juce::jmax(-60.f, juce::Decibels::gainToDecibels(std::sqrt(squares / (float)total.numSamples))); };
+        auto peakDecibels = [](float peak) { return juce::jmax(-60.f, juce::Decibels::gainToDecibels(peak)); };
+
+        meterL.setTarget(rmsDecibels(total.inSquares[0]), peakDecibels(total.inPeak[0]));
+        meterR.setTarget(rmsDecibels(total.inSquares[1]), peakDecibels(total.inPeak[1]));
+
+        outMeterL.setTarget(rmsDecibels(total.outSquares[0]), peakDecibels(total.outPeak[0]));
+        outMeterR.setTarget(rmsDecibels(total.outSquares[1]), peakDecibels(total.outPeak[1]));
+    }
+
+    //each meter only repaints its own bar, and only when what it shows changed
+    auto now = juce::Time::getMillisecondCounterHiRes() * .001;
+    meterL.tick(now);
+    meterR.tick(now);
+    outMeterL.tick(now);
+    outMeterR.tick(now);
 }
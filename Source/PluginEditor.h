@@ -11,10 +11,18 @@
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
 
+//set to 1 in the Projucer preprocessor definitions to composite the editor with OpenGL. Off by default, the
+//software renderer with its pre-rendered images is the path that behaves the same in every host
+#ifndef SIMPLEDELAY_USE_OPENGL
+ #define SIMPLEDELAY_USE_OPENGL 0
+#endif
+
+#define SIMPLEDELAY_OPENGL_EDITOR (SIMPLEDELAY_USE_OPENGL && JUCE_MODULE_AVAILABLE_juce_opengl)
+
 //==============================================================================
 /**
 */
-class SimpleDelayAudioProcessorEditor  : public juce::AudioProcessorEditor, public juce::Timer
+class SimpleDelayAudioProcessorEditor  : public juce::AudioProcessorEditor
 {
 public:
     SimpleDelayAudioProcessorEditor (SimpleDelayAudioProcessor&);
@@ -24,7 +32,10 @@ public:
     void paint (juce::Graphics&) override;
     void resized() override;
 
-    void timerCallback();
+    void updateMeters();
+
+    //Time knobs follow the note divisions while synced, the right one the left division while linked
+    void updateSyncDisplay();
 
     struct Laf : juce::LookAndFeel_V4 {
 
@@ -37,7 +48,6 @@ public:
         {
             using namespace juce;
 
-            auto unfill = Colour(15u, 15u, 15u);
             auto fill = Colour(64u, 194u, 230u);
 
             auto boundsFull = Rectangle<int>(x, y, width, height).toFloat();
@@ -50,18 +60,9 @@ public:
 
             auto rootTwo = MathConstants<float>::sqrt2;
 
-            Path backgroundArc;
-            backgroundArc.addCentredArc(bounds.getCentreX(),
-                bounds.getCentreY(),
-                arcRadius,
-                arcRadius,
-                0.0f,
-                rotaryStartAngle,
-                rotaryEndAngle,
-                true);
-
-            g.setColour(unfill);
-            g.strokePath(backgroundArc, PathStrokeType(lineW / 2, PathStrokeType::curved, PathStrokeType::rounded));
+            //background arc, gradient disc and outline come from the cache, only the moving parts are drawn here
+            auto scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+            g.drawImage(getKnobBody(width, height, scale, rotaryStartAngle, rotaryEndAngle), boundsFull);
 
             if (slider.isEnabled())
             {
@@ -79,18 +80,6 @@ public:
                 g.strokePath(valueArc, PathStrokeType(lineW / 2, PathStrokeType::curved, PathStrokeType::rounded));
             }
 
-            //make circle with gradient
-            float radialBlur = radius * 2.5;
-
-            auto grad = ColourGradient::ColourGradient(Colour(186u, 34u, 34u), bounds.getCentreX(), bounds.getCentreY(), Colours::black, radialBlur, radialBlur, true);
-
-            g.setGradientFill(grad);
-            g.fillRoundedRectangle(boundsFull.getCentreX() - (radius * rootTwo / 2), boundsFull.getCentreY() - (radius * rootTwo / 2), radius * rootTwo, radius * rootTwo, radius * .7);
-
-            //add circle around dial
-            g.setColour(Colours::lightslategrey);
-            g.drawRoundedRectangle(boundsFull.getCentreX() - (radius * rootTwo / 2), boundsFull.getCentreY() - (radius * rootTwo / 2), radius * rootTwo, radius * rootTwo, radius * .7, 1.5f);
-
             //make dial line
             g.setColour(Colours::whitesmoke);
             Point<float> thumbPoint(bounds.getCentreX() + radius / rootTwo * std::cos(toAngle - MathConstants<float>::halfPi), //This is one is farthest from center.
@@ -102,45 +91,131 @@ public:
             g.drawLine(shortLine.getX(), shortLine.getY(), thumbPoint.getX(), thumbPoint.getY(), lineW / 2);
 
             //Add text Values
-            auto const fontSize = 15.f;
-
-            auto str = String('none');
-            auto value = slider.getValue();
-            if (value <= 1) {
-                value *= 100;
-                str = String(value);
-                str.append("%", 3);
-            }
-            else {
-                str = String(value);
-                str.append(" ms", 5);
-            }
-
-            auto strWidth = g.getCurrentFont().getStringWidth(str);
+            g.setFont(knobFontSize);
+            auto& label = getKnobLabel(slider, g.getCurrentFont());
 
             Rectangle<float> r;
             r.setBottom(boundsFull.getBottom() - 10);
-            r.setLeft(boundsFull.getCentre().getX() - strWidth);
-            r.setRight(boundsFull.getCentre().getX() + strWidth);
+            r.setLeft(boundsFull.getCentre().getX() - label.textWidth);
+            r.setRight(boundsFull.getCentre().getX() + label.textWidth);
             r.setTop(boundsFull.getBottom() - 30);
 
             g.setColour(Colours::whitesmoke);
-            g.setFont(fontSize);
-            g.drawFittedText(str, r.getX(), r.getY(), r.getWidth(), r.getHeight(), juce::Justification::centred, 1);
+            g.drawFittedText(label.text, r.getX(), r.getY(), r.getWidth(), r.getHeight(), juce::Justification::centred, 1);
 
-            auto name = slider.getName();
-            strWidth = g.getCurrentFont().getStringWidth(name);
             r.setTop(0);
-            r.setLeft(boundsFull.getCentre().getX() - strWidth);
-            r.setRight(boundsFull.getCentre().getX() + strWidth);
+            r.setLeft(boundsFull.getCentre().getX() - label.nameWidth);
+            r.setRight(boundsFull.getCentre().getX() + label.nameWidth);
             r.setBottom(20);
-            g.setColour(Colours::whitesmoke);
-            g.drawFittedText(name, r.getX(), r.getY(), r.getWidth(), r.getHeight(), juce::Justification::centred, 1);
-            
+            g.drawFittedText(label.name, r.getX(), r.getY(), r.getWidth(), r.getHeight(), juce::Justification::centred, 1);
+        }
+
+        //the parts of a knob that don't move, rendered once per size and display scale
+        const juce::Image& getKnobBody(int width, int height, float scale, float rotaryStartAngle, float rotaryEndAngle)
+        {
+            using namespace juce;
+
+            auto key = std::make_tuple(width, height, roundToInt(scale * 100), rotaryStartAngle, rotaryEndAngle);
+            auto cached = knobBodies.find(key);
+            if (cached != knobBodies.end())
+                return cached->second;
+
+            Image body(Image::ARGB, jmax(1, roundToInt(width * scale)), jmax(1, roundToInt(height * scale)), true);
+            Graphics g(body);
+            g.addTransform(AffineTransform::scale(scale));
+
+            auto unfill = Colour(15u, 15u, 15u);
+
+            auto boundsFull = Rectangle<int>(0, 0, width, height).toFloat();
+            auto bounds = boundsFull.reduced(10);
+
+            auto radius = jmin(bounds.getWidth(), bounds.getHeight()) / 2.0f;
+            auto lineW = jmin(8.0f, radius * 0.5f);
+            auto arcRadius = radius - lineW * 0.5f;
+
+            auto rootTwo = MathConstants<float>::sqrt2;
+
+            Path backgroundArc;
+            backgroundArc.addCentredArc(bounds.getCentreX(),
+                bounds.getCentreY(),
+                arcRadius,
+                arcRadius,
+                0.0f,
+                rotaryStartAngle,
+                rotaryEndAngle,
+                true);
+
+            g.setColour(unfill);
+            g.strokePath(backgroundArc, PathStrokeType(lineW / 2, PathStrokeType::curved, PathStrokeType::rounded));
+
+            //make circle with gradient
+            float radialBlur = radius * 2.5;
+
+            auto grad = ColourGradient::ColourGradient(Colour(186u, 34u, 34u), bounds.getCentreX(), bounds.getCentreY(), Colours::black, radialBlur, radialBlur, true);
+
+            g.setGradientFill(grad);
+            g.fillRoundedRectangle(boundsFull.getCentreX() - (radius * rootTwo / 2), boundsFull.getCentreY() - (radius * rootTwo / 2), radius * rootTwo, radius * rootTwo, radius * .7);
+
+            //add circle around dial
+            g.setColour(Colours::lightslategrey);
+            g.drawRoundedRectangle(boundsFull.getCentreX() - (radius * rootTwo / 2), boundsFull.getCentreY() - (radius * rootTwo / 2), radius * rootTwo, radius * rootTwo, radius * .7, 1.5f);
+
+            return knobBodies[key] = body;
+        }
+
+        struct KnobLabel
+        {
+            bool valid = false;
+            double value = 0;
+            juce::String text, name, synced;
+            float textWidth = 0, nameWidth = 0;
+        };
+
+        //value text and the string widths are only rebuilt when the value, name or synced division actually changes
+        const KnobLabel& getKnobLabel(juce::Slider& slider, const juce::Font& font)
+        {
+            using namespace juce;
+
+            auto& label = knobLabels[&slider];
+            auto value = slider.getValue();
+
+            //a synced Time knob shows the note division it is following instead of its own value
+            auto synced = slider.getProperties()[syncedTextId].toString();
+
+            if (!label.valid || label.value != value || label.synced != synced) {
+                label.value = value;
+                label.synced = synced;
+                if (synced.isNotEmpty()) {
+                    label.text = synced;
+                }
+                else if (slider.getTextValueSuffix().isNotEmpty()) {
+                    label.text = slider.getTextFromValue(value);
+                }
+                else if (value <= 1) {
+                    label.text = String(value * 100);
+                    label.text.append("%", 3);
+                }
+                else {
+                    label.text = String(value);
+                    label.text.append(" ms", 5);
+                }
+                label.textWidth = font.getStringWidthFloat(label.text);
+            }
 
+            if (!label.valid || label.name != slider.getName()) {
+                label.name = slider.getName();
+                label.nameWidth = font.getStringWidthFloat(label.name);
+            }
 
+            label.valid = true;
+            return label;
         }
 
+        static constexpr float knobFontSize = 15.f;
+        static inline const juce::Identifier syncedTextId{ "syncedText" };
+        std::map<std::tuple<int, int, int, float, float>, juce::Image> knobBodies;
+        std::map<const juce::Slider*, KnobLabel> knobLabels;
+
         void drawToggleButton(juce::Graphics& g, juce::ToggleButton& button,
             bool shouldDrawButtonAsHighlighted, bool shouldDrawButtonAsDown)
         {
@@ -180,48 +255,146 @@ public:
         {
             using namespace juce;
 
+            //the empty bar and the full gradient bar are pre-rendered, the level is just a clip on the full one
+            g.drawImage(emptyBar, barBounds);
+
+            auto levelMeterFill = jmap(jlimit(-60.f, 6.f, level), -60.f, +6.f, 0.f, barBounds.getHeight());
+            {
+                Graphics::ScopedSaveState state(g);
+                g.reduceClipRegion(barBounds.withTop(barBounds.getBottom() - levelMeterFill).getSmallestIntegerContainer());
+                g.drawImage(fullBar, barBounds);
+            }
+
+            //peak hold marker
+            if (peak > -60.f) {
+                auto peakY = barBounds.getBottom() - jmap(jmin(peak, 6.f), -60.f, +6.f, 0.f, barBounds.getHeight());
+                g.setColour(Colours::whitesmoke);
+                g.drawHorizontalLine(roundToInt(peakY), barBounds.getX() + 2.f, barBounds.getRight() - 2.f);
+            }
+        }
+
+        void resized() override
+        {
+            using namespace juce;
+
             //shapes the meters. May be a bit inefficeint, not sure the best way to move this stuff around, but it is there.
             auto bounds = getLocalBounds().toFloat();
             bounds = bounds.removeFromLeft(bounds.getWidth() * .75);
             bounds = bounds.removeFromRight(bounds.getWidth() * .66);
             bounds = bounds.removeFromTop(bounds.getHeight() * .9);
-            bounds = bounds.removeFromBottom(bounds.getHeight() * .88);
+            barBounds = bounds.removeFromBottom(bounds.getHeight() * .88);
 
-            //get our base rectangle
-            g.setColour(Colours::black);
-            g.fillRoundedRectangle(bounds, 5.f);
+            auto scale = Component::getApproximateScaleFactorForComponent(this);
+            auto imageWidth = jmax(1, roundToInt(barBounds.getWidth() * scale));
+            auto imageHeight = jmax(1, roundToInt(barBounds.getHeight() * scale));
+            auto area = Rectangle<float>(barBounds.getWidth(), barBounds.getHeight());
 
-            //get gradient
-            auto gradient = ColourGradient::ColourGradient(Colours::green, bounds.getBottomLeft(), Colours::red, bounds.getTopLeft(), false);
-            gradient.addColour(.5f, Colours::yellow);
-            g.setGradientFill(gradient);
+            emptyBar = Image(Image::ARGB, imageWidth, imageHeight, true);
+            {
+                Graphics g(emptyBar);
+                g.addTransform(AffineTransform::scale(scale));
+                g.setColour(Colours::black);
+                g.fillRoundedRectangle(area, 5.f);
+            }
 
-            //Show gradient
-            auto levelMeterFill = jmap(level, -60.f, +6.f, 0.f, static_cast<float>(bounds.getHeight()));
-            g.fillRoundedRectangle(bounds.removeFromBottom(levelMeterFill), 5.f);
+            fullBar = Image(Image::ARGB, imageWidth, imageHeight, true);
+            {
+                Graphics g(fullBar);
+                g.addTransform(AffineTransform::scale(scale));
+                auto gradient = ColourGradient(Colours::green, area.getBottomLeft(), Colours::red, area.getTopLeft(), false);
+                gradient.addColour(.5f, Colours::yellow);
+                g.setGradientFill(gradient);
+                g.fillRoundedRectangle(area, 5.f);
+            }
         }
 
-        //default value so the meters  are black when the plugin is launched
-        void setLevel(float value) { level = value; }
+        //latest integrated reading from the processor, the displayed values follow it in tick()
+        void setTarget(float rmsDecibels, float peakDecibels)
+        {
+            targetLevel = rmsDecibels;
+            targetPeak = peakDecibels;
+        }
+
+        //ballistics: instant attack, fixed dB/s release, and a peak that holds before it falls. Repaints only on change.
+        void tick(double now)
+        {
+            using namespace juce;
+
+            auto elapsed = (float)jlimit(0.0, 0.1, now - lastTick);
+            lastTick = now;
+
+            auto newLevel = targetLevel >= level ? targetLevel : jmax(targetLevel, level - releaseDbPerSecond * elapsed);
+
+            auto newPeak = peak;
+            if (targetPeak >= peak) {
+                newPeak = targetPeak;
+                peakHoldUntil = now + peakHoldSeconds;
+            }
+            else if (now > peakHoldUntil) {
+                newPeak = jmax(targetPeak, peak - peakFallDbPerSecond * elapsed);
+            }
+
+            if (newLevel == level && newPeak == peak)
+                return;
+
+            level = newLevel;
+            peak = newPeak;
+            repaint(barBounds.getSmallestIntegerContainer());
+        }
 
     private:
-        float level = -60.f;
+        static constexpr float releaseDbPerSecond = 24.f;
+        static constexpr float peakFallDbPerSecond = 12.f;
+        static constexpr double peakHoldSeconds = 1.0;
+
+        juce::Rectangle<float> barBounds;
+        juce::Image emptyBar, fullBar;
+
+        //default value so the meters  are black when the plugin is launched
+        float level = -60.f, peak = -60.f;
+        float targetLevel = -60.f, targetPeak = -60.f;
+        double lastTick = 0, peakHoldUntil = 0;
     };
 
 private:
 
     SimpleDelayAudioProcessor& audioProcessor;
 
+    //gradient, logo and title, rendered once per resize instead of on every repaint
+    juce::Image background, logo;
+    juce::Font titleFont;
+    juce::Rectangle<int> logoBounds, titleLeftBounds, titleRightBounds;
+
+    void renderBackground();
+
+    static constexpr int controlStripHeight = 110;
+
     Laf laf;
     LevelMeter meterR, meterL;
     LevelMeter outMeterR, outMeterL;
 
+    std::array<SimpleDelayAudioProcessor::MeterFrame, SimpleDelayAudioProcessor::meterFifoSize> meterFrames;
+
     juce::Slider freqLeft, freqRight, feedback, dryWet;
-    juce::ToggleButton link, wetAlgo;
+    juce::Slider lowCut, highCut, tilt;
+    juce::ToggleButton link, wetAlgo, sync;
+    juce::ComboBox divisionLeft, divisionRight, routing, oversampling;
+    juce::Label routingLabel, oversamplingLabel;
 
-    juce::AudioProcessorValueTreeState::SliderAttachment freqLeftAT, freqRightAT, feedbackAT, dryWetAT;
-    juce::AudioProcessorValueTreeState::ButtonAttachment linkAT, wetAlgoAT;
+    juce::AudioProcessorValueTreeState::SliderAttachment freqLeftAT, freqRightAT, feedbackAT, dryWetAT, lowCutAT, highCutAT, tiltAT;
+    juce::AudioProcessorValueTreeState::ButtonAttachment linkAT, wetAlgoAT, syncAT;
+
+    //made in the constructor once the boxes have their items, so the attachment can select the current one
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> divisionLeftAT, divisionRightAT, routingAT, oversamplingAT;
     juce::TooltipWindow toggle {this, 1000};
 
+   #if SIMPLEDELAY_OPENGL_EDITOR
+    //opt-in, composites the editor on the GPU
+    juce::OpenGLContext openGLContext;
+   #endif
+
+    //meters are driven by the display refresh rather than a fixed timer, declared last so it goes away first
+    juce::VBlankAttachment vBlank{ this, [this] { updateMeters(); } };
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SimpleDelayAudioProcessorEditor)
 };
@@ -7,7 +7,90 @@
 */
 
 #include "PluginProcessor.h"
-#include "PluginEditor.h"
+#if ! SIMPLEDELAY_HEADLESS
+ #include "PluginEditor.h"
+#endif
+
+//choices of the synced time parameters, with their length in quarter notes
+struct NoteDivision
+{
+    const char* name;
+    double beats;
+};
+
+static constexpr NoteDivision noteDivisions[] =
+{
+    { "1/64T", 1.0 / 16 * 2 / 3 }, { "1/64", 1.0 / 16 }, { "1/64D", 1.0 / 16 * 1.5 },
+    { "1/32T", 1.0 / 8 * 2 / 3 }, { "1/32", 1.0 / 8 }, { "1/32D", 1.0 / 8 * 1.5 },
+    { "1/16T", 1.0 / 4 * 2 / 3 }, { "1/16", 1.0 / 4 }, { "1/16D", 1.0 / 4 * 1.5 },
+    { "1/8T", 1.0 / 2 * 2 / 3 }, { "1/8", 1.0 / 2 }, { "1/8D", 1.0 / 2 * 1.5 },
+    { "1/4T", 1.0 * 2 / 3 }, { "1/4", 1.0 }, { "1/4D", 1.0 * 1.5 },
+    { "1/2T", 2.0 * 2 / 3 }, { "1/2", 2.0 }, { "1/2D", 2.0 * 1.5 },
+    { "1/1T", 4.0 * 2 / 3 }, { "1/1", 4.0 }, { "1/1D", 4.0 * 1.5 }
+};
+
+//2x2 mixes applied to each channel pair, rows are the destination channel: what goes into the two rings, which
+//ring each one is fed back from, and how the rings come back out. Index is the "routing" parameter.
+struct RoutingMatrix
+{
+    using Mix = float[2][2];
+    Mix input, feedback, output;
+
+    static bool isIdentity(const Mix& m) { return m[0][0] == 1 && m[0][1] == 0 && m[1][0] == 0 && m[1][1] == 1; }
+};
+
+//the speaker pairs the routing treats as a left and a right side
+static constexpr std::pair<juce::AudioChannelSet::ChannelType, juce::AudioChannelSet::ChannelType> leftRightPairs[] =
+{
+    { juce::AudioChannelSet::left, juce::AudioChannelSet::right },
+    { juce::AudioChannelSet::leftCentre, juce::AudioChannelSet::rightCentre },
+    { juce::AudioChannelSet::leftSurround, juce::AudioChannelSet::rightSurround },
+    { juce::AudioChannelSet::leftSurroundSide, juce::AudioChannelSet::rightSurroundSide },
+    { juce::AudioChannelSet::leftSurroundRear, juce::AudioChannelSet::rightSurroundRear },
+    { juce::AudioChannelSet::wideLeft, juce::AudioChannelSet::wideRight },
+    { juce::AudioChannelSet::topFrontLeft, juce::AudioChannelSet::topFrontRight },
+    { juce::AudioChannelSet::topSideLeft, juce::AudioChannelSet::topSideRight },
+    { juce::AudioChannelSet::topRearLeft, juce::AudioChannelSet::topRearRight }
+};
+
+static bool isLeftRightPair(const juce::AudioChannelSet& layout, int firstChannel)
+{
+    if (firstChannel + 1 >= layout.size())
+        return false;
+
+    auto pair = std::make_pair(layout.getTypeOfChannel(firstChannel), layout.getTypeOfChannel(firstChannel + 1));
+    return std::find(std::begin(leftRightPairs), std::end(leftRightPairs), pair) != std::end(leftRightPairs);
+}
+
+static constexpr RoutingMatrix routingMatrices[] =
+{
+    //Normal: each side only repeats itself
+    { { { 1, 0 }, { 0, 1 } }, { { 1, 0 }, { 0, 1 } }, { { 1, 0 }, { 0, 1 } } },
+
+    //Ping-Pong: both sides go into the left ring, and every repeat jumps to the other side
+    { { { .5f, .5f }, { 0, 0 } }, { { 0, 1 }, { 1, 0 } }, { { 1, 0 }, { 0, 1 } } },
+
+    //Cross-Feed: each side goes into its own ring, and every repeat jumps to the other side
+    { { { 1, 0 }, { 0, 1 } }, { { 0, 1 }, { 1, 0 } }, { { 1, 0 }, { 0, 1 } } },
+
+    //Mid/Side: the rings hold mid (left time) and side (right time), decoded back to left and right on the way out
+    { { { .5f, .5f }, { .5f, -.5f } }, { { 1, 0 }, { 0, 1 } }, { { 1, 1 }, { 1, -1 } } }
+};
+
+//Order of the values in the binary state. Only ever append to this, and bump stateVersion when you do.
+static constexpr const char* stateParameterIds[] = {
+    "freqLeft", "freqRight", "feedback", "dryWet", "link", "wetAlgo",
+    "satQuality", "oversampling", "sync", "divisionLeft", "divisionRight",
+    "parallelChannels", "interpolation", "lowCut", "highCut", "tilt",
+
+    //version 2
+    "routing"
+};
+
+//the parameters the feedback tone filter is designed from
+static const char* const toneParameterIds[] = { "lowCut", "highCut", "tilt" };
+
+static_assert(std::size(stateParameterIds) == SimpleDelayAudioProcessor::numStateParameters, "numStateParameters is out of date");
 
 //==============================================================================
 SimpleDelayAudioProcessor::SimpleDelayAudioProcessor()
@@ -28,10 +111,38 @@ SimpleDelayAudioProcessor::SimpleDelayAudioProcessor()
     dryWet = dynamic_cast<juce::AudioParameterFloat*>(apvts.getParameter("dryWet"));
     link = dynamic_cast<juce::AudioParameterBool*>(apvts.getParameter("link"));
     wetAlgo = dynamic_cast<juce::AudioParameterBool*>(apvts.getParameter("wetAlgo"));
+    satQuality = dynamic_cast<juce::AudioParameterChoice*>(apvts.getParameter("satQuality"));
+    oversampling = dynamic_cast<juce::AudioParameterChoice*>(apvts.getParameter("oversampling"));
+    interpolation = dynamic_cast<juce::AudioParameterChoice*>(apvts.getParameter("interpolation"));
+    sync = dynamic_cast<juce::AudioParameterBool*>(apvts.getParameter("sync"));
+    divisionLeft = dynamic_cast<juce::AudioParameterChoice*>(apvts.getParameter("divisionLeft"));
+    divisionRight = dynamic_cast<juce::AudioParameterChoice*>(apvts.getParameter("divisionRight"));
+    parallelChannels = dynamic_cast<juce::AudioParameterBool*>(apvts.getParameter("parallelChannels"));
+    lowCut = dynamic_cast<juce::AudioParameterFloat*>(apvts.getParameter("lowCut"));
+    highCut = dynamic_cast<juce::AudioParameterFloat*>(apvts.getParameter("highCut"));
+    tilt = dynamic_cast<juce::AudioParameterFloat*>(apvts.getParameter("tilt"));
+    routing = dynamic_cast<juce::AudioParameterChoice*>(apvts.getParameter("routing"));
+
+    for (size_t i = 0; i < stateParameters.size(); ++i)
+    {
+        stateParameters[i] = apvts.getParameter(stateParameterIds[i]);
+        jassert(stateParameters[i] != nullptr);
+    }
+
+    for (auto* id : toneParameterIds)
+        apvts.addParameterListener(id, this);
+
+    resizeThread->addClient(this);
 }
 
 SimpleDelayAudioProcessor::~SimpleDelayAudioProcessor()
 {
+    resizeThread->removeClient(this);
+
+    for (auto* id : toneParameterIds)
+        apvts.removeParameterListener(id, this);
+
+    cancelPendingUpdate();
 }
 
 //==============================================================================
@@ -69,7 +180,20 @@ bool SimpleDelayAudioProcessor::isMidiEffect() const
 
 double SimpleDelayAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    //The longest time, repeated until the loop gain has taken it 60 dB down. The tone filter is in the loop, and
+    //wherever the tilt boosts it the repeats decay that much slower
+    auto [timeLeft, timeRight] = getDelayTimes();
+    auto longest = juce::jmax(timeLeft, timeRight) / 1000.0;
+    auto fb = (double)feedback->get() * ToneFilter<double>::getMaximumGain((double)tilt->get());
+
+    //at a loop gain of 1 or more only the saturator keeps the repeats bounded, they never die away
+    if (fb >= 1.0)
+        return std::numeric_limits<double>::infinity();
+
+    if (fb <= 0.0)
+        return longest;
+
+    return longest * (1.0 + std::log(0.001) / std::log(fb));
 }
 
 int SimpleDelayAudioProcessor::getNumPrograms()
@@ -104,32 +228,124 @@ void SimpleDelayAudioProcessor::prepareToPlay (double sampleRate, int samplesPer
     spec.numChannels = getTotalNumOutputChannels();
     spec.sampleRate = sampleRate;
 
-    for (auto& dl : delayLine)
+    //the rest of the per channel state follows the layout the host picked
+    smoothedDelay.resize(spec.numChannels);
+    smoothedFeedback.resize(spec.numChannels);
+    smoothedDryWet.resize(spec.numChannels);
+    channelMeters.resize(spec.numChannels);
+
+    //The delay starts on the current times rather than ramping in from half a second. The ring is silent either way,
+    //and this way it only has to be as long as the times are.
+    auto times = getDelayTimes();
+
+    for (size_t channel = 0; channel < smoothedDelay.size(); ++channel)
     {
-        dl.reset();
-        dl.prepare(spec);
-        dl.setMaximumDelayInSamples(sampleRate * 3.1);
+        smoothedDelay[channel].reset(sampleRate, .05);
+        smoothedDelay[channel].setCurrentAndTargetValue((channel % 2 == 0 ? times.first : times.second) / 1000);
     }
 
-    for (auto& s : smoothedDelay)
+    //the first block's ramp starts from the values it is prepared with
+    lastBlockParams.timeLeft = times.first;
+    lastBlockParams.timeRight = times.second;
+    lastBlockParams.feedback = feedback->get();
+    lastBlockParams.dryWet = dryWet->get();
+
+    reachableDelay.store((int)std::ceil(juce::jmax(times.first, times.second) / 1000.0 * sampleRate), std::memory_order_relaxed);
+
+    for (auto& s : smoothedFeedback)
     {
         s.reset(sampleRate, .05);
-        s.setCurrentAndTargetValue(.5);
+        s.setCurrentAndTargetValue(feedback->get());
     }
 
-    auto filterCoe = juce::dsp::IIR::Coefficients<float>::makeFirstOrderHighPass(sampleRate, 200);
-    for (auto& f : filters)
+    for (auto& s : smoothedDryWet)
     {
-        f.prepare(spec);
-        f.coefficients = filterCoe;
+        s.reset(sampleRate, .05);
+        s.setCurrentAndTargetValue(dryWet->get());
+    }
+
+    lastToneSettings = { sampleRate, lowCut->get(), highCut->get(), tilt->get() };
+
+    subBlockParams.resize((size_t)juce::jmax(1, (samplesPerBlock + subBlockSize - 1) / subBlockSize));
+
+    //Wide layouts get helper threads that take whole channel pairs, stereo never pays for the synchronisation.
+    //Every thread has its own kernel scratch.
+    auto numPairs = ((int)spec.numChannels + 1) / 2;
+
+    auto layout = getChannelLayoutOfBus(false, 0);
+    routedPairs.resize((size_t)numPairs);
+    for (int pair = 0; pair < numPairs; ++pair)
+        routedPairs[(size_t)pair] = isLeftRightPair(layout, pair * 2);
+
+    auto numWorkers = (int)spec.numChannels >= minParallelChannels
+                    ? juce::jmin(maxWorkers, juce::SystemStats::getNumCpus() - 1, numPairs - 1)
+                    : 0;
+
+    //the resize thread stays out of the rings until they're ready
+    const juce::ScopedLock sl(resizeLock);
+    oversizedSince = 0;
+
+    //only the precision the host asked for gets any memory, the other engine is emptied
+    if (isUsingDoublePrecision()) {
+        prepareEngine(doubleEngine, (int)spec.numChannels, sampleRate, samplesPerBlock, numWorkers);
+        prepareEngine(floatEngine, 0, sampleRate, 0, 0);
+        workerPool.prepare(numWorkers, numPairs, [this](int pair, int slot) { processChannelPair<double>(pair, slot); });
     }
+    else {
+        prepareEngine(floatEngine, (int)spec.numChannels, sampleRate, samplesPerBlock, numWorkers);
+        prepareEngine(doubleEngine, 0, sampleRate, 0, 0);
+        workerPool.prepare(numWorkers, numPairs, [this](int pair, int slot) { processChannelPair<float>(pair, slot); });
+    }
+
+    activeOversampling = -1;
+    activeInterpolation = -1;
+    asleep = false;
+    silentSamples = 0;
+
+    //the oversampler only sits in the feedback loop and its delay is compensated there, so the dry path and the plugin stay latency free
+    setLatencySamples(0);
+}
+
+template <typename SampleType>
+void SimpleDelayAudioProcessor::prepareEngine(Engine<SampleType>& engine, int numChannels, double sampleRate, int samplesPerBlock, int numWorkers)
+{
+    //One planar ring for all channels, only as long as the current times, the resize thread grows it when they go
+    //up. Offline renders get the full range up front, so what they output never depends on that thread.
+    auto maxDelay = isNonRealtime() ? getFullRangeDelay(sampleRate) : reachableDelay.load(std::memory_order_relaxed);
+    engine.delayBuffer.prepare(numChannels, maxDelay, samplesPerBlock);
 
+    //designed here once so the first block is right, after that parameterChanged keeps them up to date
+    engine.toneFilter.prepare(numChannels, designToneFilter<SampleType>(lastToneSettings));
+
+    //the kernel never sees more than one sub-block, plus room for the extra taps of the widest interpolator
+    engine.workerScratch.resize((size_t)numWorkers + 1);
+    for (auto& scratch : engine.workerScratch)
+        scratch.setSize(numScratchRows, subBlockSize + DelayBufferBase::sincTaps);
+
+    //2x and 4x for every channel, so switching factor never allocates. Linear phase with an integer
+    //latency, which the kernel takes off the read position so the repeats stay on time.
+    engine.oversamplers.resize((size_t)numChannels);
+    for (auto& channelOversamplers : engine.oversamplers)
+    {
+        for (size_t i = 0; i < channelOversamplers.size(); ++i)
+        {
+            channelOversamplers[i] = std::make_unique<juce::dsp::Oversampling<SampleType>>(1, i + 1, juce::dsp::Oversampling<SampleType>::filterHalfBandFIREquiripple, true, true);
+            channelOversamplers[i]->initProcessing((size_t)engine.workerScratch[0].getNumSamples());
+        }
+    }
 }
 
 void SimpleDelayAudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
+    workerPool.stop();
+
+   #if SIMPLEDELAY_ENABLE_PROFILING
+    auto file = juce::File::getSpecialLocation(juce::File::tempDirectory).getChildFile("SimpleDelay-profile.txt");
+    file.appendText(juce::Time::getCurrentTime().toString(true, true) + juce::newLine + profiler.toString() + juce::newLine);
+    profiler.reset();
+   #endif
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -140,8 +356,9 @@ bool SimpleDelayAudioProcessor::isBusesLayoutSupported (const BusesLayout& layou
     return true;
   #else
 
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    //any layout from mono up to surround and ambisonic beds, even channels take the left time and odd ones the right.
+    //The routing only applies to the left/right pairs of the layout
+    if (layouts.getMainOutputChannelSet().isDisabled())
         return false;
 
     // This checks if the input layout matches the output layout
@@ -156,106 +373,800 @@ bool SimpleDelayAudioProcessor::isBusesLayoutSupported (const BusesLayout& layou
 #endif
 
 void SimpleDelayAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+    process(buffer);
+}
+
+void SimpleDelayAudioProcessor::processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+    process(buffer);
+}
+
+//the whole block for either precision, the host's samples are processed as they come with no conversion
+template <typename SampleType>
+void SimpleDelayAudioProcessor::process(juce::AudioBuffer<SampleType>& buffer)
 {
     juce::ScopedNoDenormals noDenormals;
+    auto& engine = getEngine<SampleType>();
+    SIMPLEDELAY_PROFILE_BLOCK();
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
-    rmsLevelLeft = juce::Decibels::gainToDecibels(buffer.getRMSLevel(0, 0, buffer.getNumSamples()));
-    rmsLevelRight = juce::Decibels::gainToDecibels(buffer.getRMSLevel(1, 0, buffer.getNumSamples()));
+    for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
+        buffer.clear (i, 0, buffer.getNumSamples());
+
+    //a precision prepareToPlay didn't size has no channels to run, so the block goes through dry
+    if (juce::jmin(buffer.getNumChannels(), engine.toneFilter.getNumChannels()) == 0)
+        return;
+
+    //the host tempo is only reported once per block. getPosition() fills an Optional on the stack, nothing allocates
+    if (sync->get()) {
+        if (auto* playHead = getPlayHead())
+            if (auto position = playHead->getPosition())
+                if (auto bpm = position->getBpm(); bpm.hasValue() && *bpm > 0)
+                    hostBpm.store(*bpm, std::memory_order_relaxed);
+    }
+
+    //offline there is no deadline and maybe no message loop, so a pending tone change is designed right here
+    if (isNonRealtime())
+        handleUpdateNowIfNeeded();
+
+    //newest feedback filter coefficients, the same set for every channel and sub-block
+    engine.toneFilter.update();
+
+    //The parameters are read once per block. The continuous ones then move from where the last block left them to
+    //the new values one subBlockSize chunk at a time, so a big host block reaches the kernel as a staircase of
+    //targets instead of a single step. That costs up to a block of lag, see subBlockSize.
+    auto numSamples = buffer.getNumSamples();
+    auto numSubBlocks = juce::jmin((numSamples + subBlockSize - 1) / subBlockSize, (int)subBlockParams.size());
+
+    ParameterSnapshot current;
+    updateParameters(current);
+
+    for (int i = 0; i < numSubBlocks; ++i)
+    {
+        auto& params = subBlockParams[(size_t)i];
+        auto position = (float)(i + 1) / (float)numSubBlocks;
 
-    //added to fix graphical bug, rms levels when no music was playing was below -60
-    if (rmsLevelLeft < -60) {
-        rmsLevelLeft = -60;
+        params = current;
+        params.timeLeft = lastBlockParams.timeLeft + (current.timeLeft - lastBlockParams.timeLeft) * position;
+        params.timeRight = lastBlockParams.timeRight + (current.timeRight - lastBlockParams.timeRight) * position;
+        params.feedback = lastBlockParams.feedback + (current.feedback - lastBlockParams.feedback) * position;
+        params.dryWet = lastBlockParams.dryWet + (current.dryWet - lastBlockParams.dryWet) * position;
     }
-    if (rmsLevelRight < -60) {
-        rmsLevelRight = -60;
+
+    lastBlockParams = current;
+
+    //The ring only holds the longest time the parameters have reached so far. Anything longer is passed on to the
+    //resize thread, which allocates and fills a bigger ring, and is held at what fits until it is swapped in here.
+    engine.delayBuffer.applyResize();
+
+    auto longest = 0.0f;
+    for (int i = 0; i < numSubBlocks; ++i)
+        longest = juce::jmax(longest, subBlockParams[(size_t)i].timeLeft, subBlockParams[(size_t)i].timeRight);
+    for (auto& s : smoothedDelay)
+        longest = juce::jmax(longest, s.getCurrentValue() * 1000);
+
+    auto reachable = (int)std::ceil(longest / 1000.0 * getSampleRate());
+    reachableDelay.store(reachable, std::memory_order_relaxed);
+
+    if (reachable > engine.delayBuffer.getMaximumDelayInSamples()) {
+        //offline nothing is waited for, and the output doesn't depend on when another thread gets round to it
+        if (isNonRealtime()) {
+            const juce::ScopedLock sl(resizeLock);
+
+            engine.delayBuffer.applyResize();
+            if (reachable > engine.delayBuffer.getMaximumDelayInSamples() && engine.delayBuffer.requestResize(reachable))
+                engine.delayBuffer.applyResize();
+        }
+        else {
+            resizeThread->requestGrowth();
+        }
     }
 
-    
-    for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
-        buffer.clear (i, 0, buffer.getNumSamples());
+    auto fits = (float)((engine.delayBuffer.getMaximumDelayInSamples() - 1) / getSampleRate());
 
-    for (auto channel = 0; channel < buffer.getNumChannels(); ++channel)
-        createDelay(channel, delayLine[channel], buffer);
+    for (int i = 0; i < numSubBlocks; ++i)
+    {
+        auto& params = subBlockParams[(size_t)i];
+        params.timeLeft = juce::jmin(params.timeLeft, fits * 1000);
+        params.timeRight = juce::jmin(params.timeRight, fits * 1000);
+    }
+
+    current.timeLeft = juce::jmin(current.timeLeft, fits * 1000);
+    current.timeRight = juce::jmin(current.timeRight, fits * 1000);
+
+    //only after a shrink raced a knob going back up, the ramp jumps rather than reading past the ring
+    for (auto& s : smoothedDelay)
+        if (s.getCurrentValue() > fits)
+            s.setCurrentAndTargetValue(fits);
+
+    //Asleep: nothing louder than silenceThreshold has gone into the input or the ring for longer than the ring is long,
+    //so the ring, filters and oversamplers were cleared and the block only has to be checked. The smoothers still move
+    //so that waking up carries on from exactly where full processing would have been.
+    if (asleep) {
+        if (! hasSignal(buffer)) {
+            auto& params = current;
 
+            for (size_t channel = 0; channel < smoothedDelay.size(); ++channel)
+            {
+                smoothedDelay[channel].setTargetValue((channel % 2 == 0 ? params.timeLeft : params.timeRight) / 1000);
+                smoothedFeedback[channel].setTargetValue(params.feedback);
+                smoothedDryWet[channel].setTargetValue(params.dryWet);
+                smoothedDelay[channel].skip(numSamples);
+                smoothedFeedback[channel].skip(numSamples);
+                smoothedDryWet[channel].skip(numSamples);
+            }
+
+            pendingMeterFrame.numSamples += numSamples;
+            pushMeterFrame();
+            return;
+        }
+
+        asleep = false;
+        silentSamples = 0;
+    }
 
-    rmsOutLevelLeft = juce::Decibels::gainToDecibels(buffer.getRMSLevel(0, 0, buffer.getNumSamples()));
-    rmsOutLevelRight = juce::Decibels::gainToDecibels(buffer.getRMSLevel(1, 0, buffer.getNumSamples()));
+    //Each channel then runs through all of its sub-blocks on its own, which is what lets wide layouts hand whole
+    //channels to the worker pool. The kernel works in place on the host's channels, nothing is copied.
+    engine.currentBuffer = &buffer;
 
-    //added to fix graphical bug, rms levels when no music was playing was below -60
-    if (rmsOutLevelLeft < -60) {
-        rmsOutLevelLeft = -60;
+    if (parallelChannels->get() && workerPool.getNumWorkers() > 0) {
+        workerPool.run();
     }
-    if (rmsOutLevelRight < -60) {
-        rmsOutLevelRight = -60;
+    else {
+        for (auto pair = 0; pair < (engine.toneFilter.getNumChannels() + 1) / 2; ++pair)
+            processChannelPair<SampleType>(pair, 0);
     }
 
+    engine.delayBuffer.advance(numSamples);
+
+    //the kernel also kept the peak of everything it wrote into the ring
+    auto blockPeak = 0.0f;
+    for (auto& meter : channelMeters)
+        blockPeak = juce::jmax(blockPeak, meter.inPeak, meter.delayPeak);
+
+    silentSamples = blockPeak > silenceThreshold ? 0 : silentSamples + numSamples;
+
+    if (silentSamples > engine.delayBuffer.getCapacity())
+        goToSleep(engine);
+
+    //The kernel measured its input and output on the way through. Even channels feed the left meter and odd ones
+    //the right, averaged so a surround bed reads like a stereo pair. Mono shows the same signal on both.
+    auto numChannels = juce::jmin(buffer.getNumChannels(), engine.toneFilter.getNumChannels());
+
+    for (int side = 0; side < 2; ++side)
+    {
+        auto first = juce::jmin(side, numChannels - 1);
+        auto weight = 1.0f / (float)((numChannels - first + 1) / 2);
+
+        for (int channel = first; channel < numChannels; channel += 2)
+        {
+            auto& meter = channelMeters[(size_t)channel];
+            pendingMeterFrame.inSquares[side] += meter.inSquares * weight;
+            pendingMeterFrame.outSquares[side] += meter.outSquares * weight;
+            pendingMeterFrame.inPeak[side] = juce::jmax(pendingMeterFrame.inPeak[side], meter.inPeak);
+            pendingMeterFrame.outPeak[side] = juce::jmax(pendingMeterFrame.outPeak[side], meter.outPeak);
+        }
+    }
+
+    pendingMeterFrame.numSamples += numSamples;
+    pushMeterFrame();
+}
+
+//true if any input channel has a sample above silenceThreshold
+template <typename SampleType>
+bool SimpleDelayAudioProcessor::hasSignal(const juce::AudioBuffer<SampleType>& buffer) const
+{
+    for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+    {
+        auto range = juce::FloatVectorOperations::findMinAndMax(buffer.getReadPointer(channel), buffer.getNumSamples());
+        if (juce::jmax(-range.getStart(), range.getEnd()) > (SampleType)silenceThreshold)
+            return true;
+    }
+
+    return false;
+}
+
+//everything left in the ring and the filters is below silenceThreshold, so it's dropped rather than processed forever
+template <typename SampleType>
+void SimpleDelayAudioProcessor::goToSleep(Engine<SampleType>& engine)
+{
+    engine.delayBuffer.reset();
+    engine.toneFilter.reset();
+
+    for (auto& channelOversamplers : engine.oversamplers)
+        for (auto& o : channelOversamplers)
+            o->reset();
+
+    asleep = true;
+}
+
+//all of one channel pair's sub-blocks, on the audio thread or a worker (slot picks the scratch).
+//The routing mixes the two rings of a left/right pair, so a pair is the smallest piece that can run on its own.
+template <typename SampleType>
+void SimpleDelayAudioProcessor::processChannelPair(int pair, int slot)
+{
+    auto& engine = getEngine<SampleType>();
+    auto& buffer = *engine.currentBuffer;
+    auto numSamples = buffer.getNumSamples();
+    auto firstChannel = pair * 2;
+    auto numLines = juce::jmin(2, buffer.getNumChannels() - firstChannel, engine.toneFilter.getNumChannels() - firstChannel);
+
+    if (numLines < 1)
+        return;
+
+    auto routed = numLines == 2 && pair < (int)routedPairs.size() && routedPairs[(size_t)pair];
+
+    for (int channel = firstChannel; channel < firstChannel + numLines; ++channel)
+        channelMeters[(size_t)channel] = {};
+
+    for (int start = 0, i = 0; start < numSamples; start += subBlockSize, ++i)
+    {
+        auto& params = subBlockParams[(size_t)juce::jmin(i, (int)subBlockParams.size() - 1)];
+        createDelay(firstChannel, numLines, routed, engine, buffer, start, juce::jmin(subBlockSize, numSamples - start), params, engine.workerScratch[(size_t)slot]);
+    }
+}
+
+//delay times in ms, from the host tempo when synced. Link is applied here rather than trusted to the editor,
+//so it holds under automation and with no editor open. Any thread
+std::pair<float, float> SimpleDelayAudioProcessor::getDelayTimes() const
+{
+    auto linked = link->get();
+
+    if (! sync->get())
+        return { freqLeft->get(), linked ? freqLeft->get() : freqRight->get() };
+
+    auto msPerBeat = 60000.0 / hostBpm.load(std::memory_order_relaxed);
+    auto rightDivision = linked ? divisionLeft->getIndex() : divisionRight->getIndex();
+    return { juce::jlimit(freqLeft->range.start, freqLeft->range.end, (float)(msPerBeat * noteDivisions[divisionLeft->getIndex()].beats)),
+             juce::jlimit(freqRight->range.start, freqRight->range.end, (float)(msPerBeat * noteDivisions[rightDivision].beats)) };
 }
 
-void SimpleDelayAudioProcessor::createDelay(int channel, juce::dsp::DelayLine<float, juce::dsp::DelayLineInterpolationTypes::Linear> &delayLine, juce::AudioBuffer<float>& buffer)
+//snapshots the parameters so the kernel does no atomic loads
+void SimpleDelayAudioProcessor::updateParameters(ParameterSnapshot& params)
 {
-    auto delayTime = 0;
+    //in sync the new time goes through smoothedDelay like a knob move, so tempo changes ramp instead of jumping
+    std::tie(params.timeLeft, params.timeRight) = getDelayTimes();
+
+    params.feedback = feedback->get();
+    params.dryWet = dryWet->get();
+    params.wetAlgo = wetAlgo->get();
+    params.sampleRate = getSampleRate();
+    params.oversampling = oversampling->getIndex();
+    params.routing = routing->getIndex();
 
-    if (channel == 0) {
-        smoothedDelay[channel].setTargetValue((freqLeft->get() / 1000));
+    //a factor that was idle has stale filter state from the last time it was used, the unused engine has none to reset
+    auto resetOversamplers = [](auto& engine)
+    {
+        for (auto& channelOversamplers : engine.oversamplers)
+            for (auto& o : channelOversamplers)
+                o->reset();
+    };
+
+    if (params.oversampling != activeOversampling) {
+        resetOversamplers(floatEngine);
+        resetOversamplers(doubleEngine);
+        activeOversampling = params.oversampling;
     }
-    else {
-        smoothedDelay[channel].setTargetValue((freqRight->get() / 1000));
+
+    //offline renders don't care about CPU, so they always get the best interpolator
+    auto interpolationIndex = isNonRealtime() ? (int)DelayBufferBase::Interpolation::windowedSinc : interpolation->getIndex();
+    params.interpolation = static_cast<DelayBufferBase::Interpolation>(interpolationIndex);
+
+    //the Thiran allpass carries state that is stale if it wasn't the one running
+    if (interpolationIndex != activeInterpolation) {
+        floatEngine.delayBuffer.resetInterpolation();
+        doubleEngine.delayBuffer.resetInterpolation();
+        activeInterpolation = interpolationIndex;
+    }
+
+    saturator.setQuality(static_cast<Saturator::Quality>(satQuality->getIndex()));
+}
+
+void SimpleDelayAudioProcessor::pushMeterFrame()
+{
+    const auto scope = meterFifo.write(1);
+
+    //fifo full means nobody is reading (no editor open), drop the frame rather than let it grow without bound
+    if (scope.blockSize1 == 0) {
+        pendingMeterFrame = {};
+        return;
     }
 
-    auto& filter = filters[channel];
+    meterFrames[(size_t)scope.startIndex1] = pendingMeterFrame;
+    pendingMeterFrame = {};
+}
+
+int SimpleDelayAudioProcessor::popMeterFrames(MeterFrame* dest, int maxFrames)
+{
+    const auto scope = meterFifo.read(juce::jmin(maxFrames, meterFifo.getNumReady()));
 
-    auto block = juce::dsp::AudioBlock<float>(buffer);
-    auto context = juce::dsp::ProcessContextReplacing<float>(block);
+    std::copy_n(meterFrames.begin() + scope.startIndex1, scope.blockSize1, dest);
+    std::copy_n(meterFrames.begin() + scope.startIndex2, scope.blockSize2, dest + scope.blockSize1);
 
-    auto& inputBlock = context.getInputBlock();
-    auto& ouputBlock = context.getOutputBlock();
-    auto numSamples = ouputBlock.getNumSamples();
+    return scope.blockSize1 + scope.blockSize2;
+}
 
-    auto* input = inputBlock.getChannelPointer(channel);
-    auto* output = ouputBlock.getChannelPointer(channel);
-   
+//copies src to dest and accumulates its energy and peak in the same pass
+template <typename SampleType>
+static void copyAndMeasure(SampleType* dest, const SampleType* src, int numSamples, float& squares, float& peak)
+{
+    //four independent accumulators so the adds don't serialise on one register
+    SampleType sq[4] = {}, pk[4] = {};
+    int i = 0;
 
-    for (int i = 0; i < numSamples; i++)
+    for (; i <= numSamples - 4; i += 4)
     {
-        auto nextDelayTime = smoothedDelay[channel].getNextValue() * getSampleRate();
-        auto delayedSample = filter.processSample(delayLine.popSample(channel, nextDelayTime));
-        auto inDelay = std::tanh(input[i] + feedback->get() * delayedSample);
-        delayLine.pushSample(channel, inDelay);
-        if (wetAlgo->get()) {
-            output[i] = (input[i] * (1 - dryWet->get())) + (delayedSample * dryWet->get());
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            auto x = src[i + lane];
+            dest[i + lane] = x;
+            sq[lane] += x * x;
+            pk[lane] = juce::jmax(pk[lane], std::abs(x));
         }
-        else {
-            output[i] = std::tanh(input[i] + dryWet->get() * delayedSample);
+    }
+
+    for (; i < numSamples; ++i)
+    {
+        auto x = src[i];
+        dest[i] = x;
+        sq[0] += x * x;
+        pk[0] = juce::jmax(pk[0], std::abs(x));
+    }
+
+    squares += (float)((sq[0] + sq[1]) + (sq[2] + sq[3]));
+    peak = juce::jmax(peak, (float)juce::jmax(juce::jmax(pk[0], pk[1]), juce::jmax(pk[2], pk[3])));
+}
+
+//same as above without the copy, run right after the output is written while it is still in cache
+template <typename SampleType>
+static void measure(const SampleType* src, int numSamples, float& squares, float& peak)
+{
+    SampleType sq[4] = {}, pk[4] = {};
+    int i = 0;
+
+    for (; i <= numSamples - 4; i += 4)
+    {
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            sq[lane] += src[i + lane] * src[i + lane];
+            pk[lane] = juce::jmax(pk[lane], std::abs(src[i + lane]));
+        }
+    }
+
+    for (; i < numSamples; ++i)
+    {
+        sq[0] += src[i] * src[i];
+        pk[0] = juce::jmax(pk[0], std::abs(src[i]));
+    }
+
+    squares += (float)((sq[0] + sq[1]) + (sq[2] + sq[3]));
+    peak = juce::jmax(peak, (float)juce::jmax(juce::jmax(pk[0], pk[1]), juce::jmax(pk[2], pk[3])));
+}
+
+//2x2 mix of a channel pair in place, a = m00 a + m01 b and b = m10 a + m11 b. temp is overwritten
+template <typename SampleType>
+static void mixPair(SampleType* a, SampleType* b, const RoutingMatrix::Mix& m, SampleType* temp, int numSamples)
+{
+    using FVO = juce::FloatVectorOperations;
+
+    FVO::copy(temp, a, numSamples);
+    FVO::multiply(a, (SampleType)m[0][0], numSamples);
+    FVO::addWithMultiply(a, b, (SampleType)m[0][1], numSamples);
+    FVO::multiply(b, (SampleType)m[1][1], numSamples);
+    FVO::addWithMultiply(b, temp, (SampleType)m[1][0], numSamples);
+}
+
+template <typename SampleType>
+static void mixPair(SampleType& a, SampleType& b, const RoutingMatrix::Mix& m)
+{
+    auto oldA = a;
+    a = (SampleType)m[0][0] * a + (SampleType)m[0][1] * b;
+    b = (SampleType)m[1][0] * oldA + (SampleType)m[1][1] * b;
+}
+
+//one channel, or a pair whose rings are mixed by the routing matrix when it is routed
+template <typename SampleType>
+void SimpleDelayAudioProcessor::createDelay(int firstChannel, int numLines, bool routed, Engine<SampleType>& engine, juce::AudioBuffer<SampleType>& buffer,
+                                            int startSample, int numSamples, const ParameterSnapshot& params, juce::AudioBuffer<SampleType>& kernelScratch)
+{
+    using FVO = juce::FloatVectorOperations;
+    SIMPLEDELAY_PROFILE(delayKernel);
+
+    auto& delayBuffer = engine.delayBuffer;
+    auto& toneFilter = engine.toneFilter;
+    auto sampleRate = params.sampleRate;
+    auto interpolationMode = params.interpolation;
+
+    //a channel without a partner (mono, or the last of an odd layout) or a pair that isn't left/right is never routed
+    auto& matrix = routingMatrices[routed ? params.routing : 0];
+    auto routeInput = routed && ! RoutingMatrix::isIdentity(matrix.input);
+    auto routeFeedback = routed && ! RoutingMatrix::isIdentity(matrix.feedback);
+    auto routeOutput = routed && ! RoutingMatrix::isIdentity(matrix.output);
+
+    struct Line
+    {
+        int channel;
+        Smoothed* smoothed;
+        Smoothed* smoothedFb;
+        Smoothed* smoothedMix;
+        ChannelMeter* meter;
+        juce::dsp::Oversampling<SampleType>* oversampler;
+        SampleType latency;
+
+        //processing is in place, the channel is both the input and the output
+        SampleType* samples;
+        SampleType* delayed;
+        SampleType* satIn;
+        SampleType* fbGain;
+        SampleType* wetGain;
+        SampleType* dryGain;
+    };
+
+    std::array<Line, 2> lines{};
+
+    for (int l = 0; l < numLines; ++l)
+    {
+        auto channel = firstChannel + l;
+        auto* oversampler = params.oversampling > 0 ? engine.oversamplers[(size_t)channel][(size_t)params.oversampling - 1].get() : nullptr;
+        auto* rows = kernelScratch.getArrayOfWritePointers() + l * scratchRowsPerLine;
+
+        lines[(size_t)l] = { channel, &smoothedDelay[(size_t)channel], &smoothedFeedback[(size_t)channel], &smoothedDryWet[(size_t)channel],
+                             &channelMeters[(size_t)channel], oversampler,
+                             oversampler != nullptr ? oversampler->getLatencyInSamples() : SampleType(),
+                             buffer.getWritePointer(channel, startSample), rows[0], rows[1], rows[2], rows[3], rows[4] };
+
+        lines[(size_t)l].smoothed->setTargetValue((channel % 2 == 0 ? params.timeLeft : params.timeRight) / 1000);
+        lines[(size_t)l].smoothedFb->setTargetValue(params.feedback);
+        lines[(size_t)l].smoothedMix->setTargetValue(params.dryWet);
+    }
+
+    //tanh in the feedback loop, oversampled when asked for
+    auto saturateFeedback = [this](juce::dsp::Oversampling<SampleType>* oversampler, SampleType* data, int num)
+    {
+        if (oversampler == nullptr) {
+            saturator.process(data, num);
+            return;
+        }
+
+        juce::dsp::AudioBlock<SampleType> block(&data, 1, (size_t)num);
+        auto upsampled = oversampler->processSamplesUp(block);
+        saturator.process(upsampled.getChannelPointer(0), (int)upsampled.getNumSamples());
+        oversampler->processSamplesDown(block);
+    };
+
+    auto* spanCopy = kernelScratch.getWritePointer(sharedScratchRow);
+    auto* mixTemp = kernelScratch.getWritePointer(sharedScratchRow + 1);
+    SampleType* routedFeedback[] = { kernelScratch.getWritePointer(sharedScratchRow + 2), kernelScratch.getWritePointer(sharedScratchRow + 3) };
+    SampleType* routedOutput[] = { kernelScratch.getWritePointer(sharedScratchRow + 4), kernelScratch.getWritePointer(sharedScratchRow + 5) };
+
+    for (int start = 0; start < numSamples;)
+    {
+        //A run can be processed as a block as long as none of its reads land on a sample written inside the same run.
+        //The smoothed delay ramps linearly, so the shortest delay in the run is whichever end of the ramp is smaller,
+        //less the taps the interpolator reads ahead of it. A routed pair shares its runs, so the shorter line decides.
+        auto runLength = juce::jmin(numSamples - start, kernelScratch.getNumSamples() - DelayBufferBase::sincTaps);
+
+        for (int l = 0; l < numLines; ++l)
+        {
+            auto& line = lines[(size_t)l];
+            auto shortestDelay = (int)(juce::jmin(line.smoothed->getCurrentValue(), line.smoothed->getTargetValue()) * sampleRate - line.latency)
+                               - DelayBufferBase::getLookahead(interpolationMode);
+            runLength = juce::jmin(runLength, shortestDelay);
+        }
+
+        if (runLength < 1) {
+            //per-sample fallback, only reachable when a delay is within a few samples of zero
+            float fb[2], mix[2];
+            SampleType delayedSample[2], inDelay[2], fbSource[2], wet[2];
+
+            for (int l = 0; l < numLines; ++l)
+            {
+                auto& line = lines[(size_t)l];
+                auto nextDelayTime = line.smoothed->getNextValue() * sampleRate - line.latency;
+                fb[l] = line.smoothedFb->getNextValue();
+                mix[l] = line.smoothedMix->getNextValue();
+                delayedSample[l] = toneFilter.processSample(line.channel, delayBuffer.read(line.channel, startSample + start, nextDelayTime, interpolationMode));
+                line.meter->inSquares += (float)(line.samples[start] * line.samples[start]);
+                line.meter->inPeak = juce::jmax(line.meter->inPeak, (float)std::abs(line.samples[start]));
+                inDelay[l] = line.samples[start];
+                fbSource[l] = wet[l] = delayedSample[l];
+            }
+
+            if (routeInput)
+                mixPair(inDelay[0], inDelay[1], matrix.input);
+            if (routeFeedback)
+                mixPair(fbSource[0], fbSource[1], matrix.feedback);
+            if (routeOutput)
+                mixPair(wet[0], wet[1], matrix.output);
+
+            for (int l = 0; l < numLines; ++l)
+            {
+                auto& line = lines[(size_t)l];
+                inDelay[l] = inDelay[l] + fb[l] * fbSource[l];
+                saturateFeedback(line.oversampler, &inDelay[l], 1);
+                line.meter->delayPeak = juce::jmax(line.meter->delayPeak, (float)std::abs(inDelay[l]));
+                delayBuffer.write(line.channel, startSample + start, &inDelay[l], 1);
+                if (params.wetAlgo) {
+                    line.samples[start] = (line.samples[start] * ((SampleType)1 - mix[l])) + (wet[l] * mix[l]);
+                }
+                else {
+                    line.samples[start] = saturator.processSample(line.samples[start] + mix[l] * wet[l]);
+                }
+                line.meter->outSquares += (float)(line.samples[start] * line.samples[start]);
+                line.meter->outPeak = juce::jmax(line.meter->outPeak, (float)std::abs(line.samples[start]));
+            }
+
+            ++start;
+            continue;
+        }
+
+        //read and filter every line's run before anything is written back
+        bool fbRamping[2] = {}, mixRamping[2] = {};
+
+        for (int l = 0; l < numLines; ++l)
+        {
+            auto& line = lines[(size_t)l];
+
+            if (line.smoothed->isSmoothing()) {
+                //ramping delay: one position per sample; DelayBuffer runs Lagrange in coefficient rows, the rest per sample
+                for (int i = 0; i < runLength; i++)
+                    spanCopy[i] = (SampleType)(line.smoothed->getNextValue() * sampleRate - line.latency);
+                delayBuffer.read(line.channel, startSample + start, spanCopy, interpolationMode, line.delayed, runLength);
+            }
+            else {
+                //steady delay: fixed interpolation coefficients, so DelayBuffer runs them as vector ops over a span of the ring
+                delayBuffer.read(line.channel, startSample + start, (SampleType)(line.smoothed->getTargetValue() * sampleRate - line.latency),
+                                 interpolationMode, line.delayed, runLength, spanCopy);
+            }
+
+            {
+                SIMPLEDELAY_PROFILE(filter);
+                toneFilter.process(line.channel, line.delayed, runLength);
+            }
+
+            //gains only become per-sample while they are ramping, otherwise the scalar overloads are used
+            fbRamping[l] = line.smoothedFb->isSmoothing();
+            mixRamping[l] = line.smoothedMix->isSmoothing();
+
+            if (fbRamping[l]) {
+                for (int i = 0; i < runLength; i++)
+                    line.fbGain[i] = line.smoothedFb->getNextValue();
+            }
+
+            if (mixRamping[l]) {
+                for (int i = 0; i < runLength; i++)
+                    line.wetGain[i] = line.smoothedMix->getNextValue();
+                FVO::negate(line.dryGain, line.wetGain, runLength);
+                FVO::add(line.dryGain, (SampleType)1, runLength);
+            }
+
+            {
+                SIMPLEDELAY_PROFILE(metering);
+                copyAndMeasure(line.satIn, line.samples + start, runLength, line.meter->inSquares, line.meter->inPeak);
+            }
+        }
+
+        //the routing matrix: what goes into each ring, which ring each one is fed back from, and how they come back out
+        const SampleType* fbSource[] = { lines[0].delayed, lines[1].delayed };
+        const SampleType* wetSource[] = { lines[0].delayed, lines[1].delayed };
+
+        if (routeInput)
+            mixPair(lines[0].satIn, lines[1].satIn, matrix.input, mixTemp, runLength);
+
+        if (routeFeedback) {
+            FVO::copy(routedFeedback[0], lines[0].delayed, runLength);
+            FVO::copy(routedFeedback[1], lines[1].delayed, runLength);
+            mixPair(routedFeedback[0], routedFeedback[1], matrix.feedback, mixTemp, runLength);
+            fbSource[0] = routedFeedback[0];
+            fbSource[1] = routedFeedback[1];
+        }
+
+        if (routeOutput) {
+            FVO::copy(routedOutput[0], lines[0].delayed, runLength);
+            FVO::copy(routedOutput[1], lines[1].delayed, runLength);
+            mixPair(routedOutput[0], routedOutput[1], matrix.output, mixTemp, runLength);
+            wetSource[0] = routedOutput[0];
+            wetSource[1] = routedOutput[1];
+        }
+
+        for (int l = 0; l < numLines; ++l)
+        {
+            auto& line = lines[(size_t)l];
+            auto* run = line.samples + start;
+            auto* wet = wetSource[l];
+
+            //feedback path: tanh(input + feedback * delayed)
+            if (fbRamping[l])
+                FVO::addWithMultiply(line.satIn, fbSource[l], line.fbGain, runLength);
+            else
+                FVO::addWithMultiply(line.satIn, fbSource[l], (SampleType)line.smoothedFb->getTargetValue(), runLength);
+            saturateFeedback(line.oversampler, line.satIn, runLength);
+            {
+                SIMPLEDELAY_PROFILE(metering);
+                auto written = FVO::findMinAndMax(line.satIn, runLength);
+                line.meter->delayPeak = juce::jmax(line.meter->delayPeak, (float)-written.getStart(), (float)written.getEnd());
+            }
+            delayBuffer.write(line.channel, startSample + start, line.satIn, runLength);
+
+            //output path, same operation order as the per-sample code so the result is bit-identical
+            if (params.wetAlgo) {
+                if (mixRamping[l]) {
+                    FVO::multiply(run, line.dryGain, runLength);
+                    FVO::addWithMultiply(run, wet, line.wetGain, runLength);
+                }
+                else {
+                    FVO::multiply(run, (SampleType)1 - (SampleType)line.smoothedMix->getTargetValue(), runLength);
+                    FVO::addWithMultiply(run, wet, (SampleType)line.smoothedMix->getTargetValue(), runLength);
+                }
+            }
+            else {
+                if (mixRamping[l])
+                    FVO::addWithMultiply(run, wet, line.wetGain, runLength);
+                else
+                    FVO::addWithMultiply(run, wet, (SampleType)line.smoothedMix->getTargetValue(), runLength);
+                saturator.process(run, runLength);
+            }
+
+            {
+                SIMPLEDELAY_PROFILE(metering);
+                measure(run, runLength, line.meter->outSquares, line.meter->outPeak);
+            }
         }
+
+        start += runLength;
+    }
+}
+
+template <typename SampleType>
+typename ToneFilter<SampleType>::Coefficients SimpleDelayAudioProcessor::designToneFilter(const ToneSettings& settings) const
+{
+    return ToneFilter<SampleType>::design(std::get<0>(settings), std::get<1>(settings), std::get<2>(settings), highCut->range.end, std::get<3>(settings));
+}
+
+//any thread. A change made on the message thread is designed straight away, one from the host's automation
+//thread waits for the message loop
+void SimpleDelayAudioProcessor::parameterChanged(const juce::String& parameterID, float newValue)
+{
+    triggerAsyncUpdate();
+
+    if (juce::MessageManager::existsAndIsCurrentThread())
+        handleUpdateNowIfNeeded();
+}
+
+void SimpleDelayAudioProcessor::handleAsyncUpdate()
+{
+    const juce::ScopedLock sl(toneDesignLock);
+
+    ToneSettings settings{ getSampleRate(), lowCut->get(), highCut->get(), tilt->get() };
+
+    if (std::get<0>(settings) > 0 && settings != lastToneSettings) {
+        lastToneSettings = settings;
+        floatEngine.toneFilter.publish(designToneFilter<float>(settings));
+        doubleEngine.toneFilter.publish(designToneFilter<double>(settings));
+    }
+}
+
+void SimpleDelayAudioProcessor::resizeDelayBuffers()
+{
+    const juce::ScopedLock sl(resizeLock);
+
+    //offline the audio thread resizes for itself and a ring is never given back mid render
+    if (isNonRealtime())
+        return;
+
+    resizeDelayBuffer(floatEngine.delayBuffer);
+    resizeDelayBuffer(doubleEngine.delayBuffer);
+}
+
+bool SimpleDelayAudioProcessor::isDelayMemoryGrowing() const
+{
+    auto reachable = reachableDelay.load(std::memory_order_relaxed);
+
+    auto isGrowing = [reachable](const auto& ring)
+    {
+        return ring.getNumChannels() > 0 && reachable > ring.getMaximumDelayInSamples() && ! ring.isResizeReady();
+    };
+
+    return isGrowing(floatEngine.delayBuffer) || isGrowing(doubleEngine.delayBuffer);
+}
+
+int SimpleDelayAudioProcessor::getFullRangeDelay(double sampleRate) const
+{
+    //synced times are clamped to the same range
+    return (int)std::ceil(juce::jmax(freqLeft->range.end, freqRight->range.end) / 1000.0 * sampleRate);
+}
+
+//resize thread. Grows the ring as soon as the audio thread reaches past it, shrinks it once the times have
+//stayed short for delayMemoryReleaseTime. The audio thread swaps the new ring in at the top of its next block.
+template <typename SampleType>
+void SimpleDelayAudioProcessor::resizeDelayBuffer(DelayBuffer<SampleType>& ring)
+{
+    //the unused precision has no channels, and nothing is decided while a resize is still in flight
+    if (ring.getNumChannels() == 0 || ! ring.releaseRetired())
+        return;
+
+    auto reachable = reachableDelay.load(std::memory_order_relaxed);
+
+    if (reachable > ring.getMaximumDelayInSamples()) {
+        ring.requestResize(reachable);
+        oversizedSince = 0;
+        return;
+    }
+
+    if (DelayBuffer<SampleType>::getCapacityFor(reachable) >= ring.getCapacity()) {
+        oversizedSince = 0;
+        return;
+    }
+
+    auto now = juce::Time::getMillisecondCounter();
+
+    if (oversizedSince == 0) {
+        oversizedSince = now;
+    }
+    else if (now - oversizedSince >= (juce::uint32)(delayMemoryReleaseTime * 1000)) {
+        ring.requestResize(reachable);
+        oversizedSince = 0;
     }
 }
 
 //==============================================================================
 bool SimpleDelayAudioProcessor::hasEditor() const
 {
-    return true; // (change this to false if you choose to not supply an editor)
+    return ! SIMPLEDELAY_HEADLESS; // (change this to false if you choose to not supply an editor)
 }
 
 juce::AudioProcessorEditor* SimpleDelayAudioProcessor::createEditor()
 {
+   #if SIMPLEDELAY_HEADLESS
+    return nullptr;
+   #else
     return new SimpleDelayAudioProcessorEditor (*this);
+   #endif
 }
 
 //==============================================================================
+//Binary state, little endian: stateMagic, stateVersion, the number of values, then the plain value of every
+//parameter in stateParameterIds order as a float. Sessions with hundreds of instances load it without building
+//or parsing a ValueTree.
 void SimpleDelayAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
-    //Make sure to Save the filtergraph otherwise it will be the old state
-    juce::MemoryOutputStream mos(destData, true);
-    apvts.state.writeToStream(mos);
+    destData.ensureSize(sizeof(juce::int32) * 3 + sizeof(float) * numStateParameters);
+
+    juce::MemoryOutputStream mos(destData, false);
+    mos.writeInt(stateMagic);
+    mos.writeInt(stateVersion);
+    mos.writeInt(numStateParameters);
+
+    for (auto* param : stateParameters)
+        mos.writeFloat(param->convertFrom0to1(param->getValue()));
 }
 
 void SimpleDelayAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
-    auto tree = juce::ValueTree::readFromData(data, sizeInBytes);
-    if (tree.isValid()) {
-        apvts.replaceState(tree);
+    juce::MemoryInputStream mis(data, (size_t)sizeInBytes, false);
+
+    //anything without the magic is a ValueTree from before the binary format
+    if (sizeInBytes < (int)sizeof(juce::int32) * 3 || mis.readInt() != stateMagic) {
+        auto tree = juce::ValueTree::readFromData(data, (size_t)sizeInBytes);
+        if (tree.isValid()) {
+            apvts.replaceState(tree);
+        }
+        return;
+    }
+
+    //a newer version only ever appends, so the values this build knows about are still at the front
+    mis.readInt();
+    auto numValues = juce::jlimit(0, numStateParameters, mis.readInt());
+    numValues = juce::jmin(numValues, (int)(mis.getNumBytesRemaining() / (juce::int64)sizeof(float)));
+
+    //parameters the state predates go back to their defaults, the same as replaceState would do
+    for (int i = 0; i < numStateParameters; ++i)
+    {
+        auto* param = stateParameters[(size_t)i];
+        auto value = i < numValues ? param->convertTo0to1(mis.readFloat()) : param->getDefaultValue();
+        param->setValueNotifyingHost(value);
     }
 }
 
@@ -273,8 +1184,23 @@ juce::AudioProcessorValueTreeState::ParameterLayout SimpleDelayAudioProcessor::c
     layout.add(std::make_unique<AudioParameterFloat>("freqRight", "Frequency Right", freqRange, 50));
     layout.add(std::make_unique<AudioParameterFloat>("feedback", "Feedback", feedbackRange, .5));
     layout.add(std::make_unique<AudioParameterFloat>("dryWet", "Dry/Wet", dryWetRange, .5));
+    layout.add(std::make_unique<AudioParameterFloat>("lowCut", "Feedback Low Cut", NormalisableRange<float>(20, 2000, 1, .3f), 200));
+    layout.add(std::make_unique<AudioParameterFloat>("highCut", "Feedback High Cut", NormalisableRange<float>(1000, 20000, 1, .3f), 20000));
+    layout.add(std::make_unique<AudioParameterFloat>("tilt", "Feedback Tilt", NormalisableRange<float>(-6, 6, .1f, 1), 0));
     layout.add(std::make_unique<AudioParameterBool>("link", "Link", true));
     layout.add(std::make_unique<AudioParameterBool>("wetAlgo", "WetAlgo", false));
+    layout.add(std::make_unique<AudioParameterChoice>("satQuality", "Saturation Quality", StringArray{ "Exact", "High", "Fast" }, 0));
+    layout.add(std::make_unique<AudioParameterChoice>("oversampling", "Saturation Oversampling", StringArray{ "Off", "2x", "4x" }, 0));
+    StringArray divisions;
+    for (auto& division : noteDivisions)
+        divisions.add(division.name);
+
+    layout.add(std::make_unique<AudioParameterBool>("sync", "Sync", false));
+    layout.add(std::make_unique<AudioParameterChoice>("divisionLeft", "Division Left", divisions, 10));
+    layout.add(std::make_unique<AudioParameterChoice>("divisionRight", "Division Right", divisions, 10));
+    layout.add(std::make_unique<AudioParameterBool>("parallelChannels", "Parallel Channels", false));
+    layout.add(std::make_unique<AudioParameterChoice>("interpolation", "Interpolation", StringArray{ "Linear", "Lagrange", "Thiran" }, 0));
+    layout.add(std::make_unique<AudioParameterChoice>("routing", "Routing", StringArray{ "Normal", "Ping-Pong", "Cross-Feed", "Mid/Side" }, 0));
 
     return layout;
 }
@@ -285,31 +1211,3 @@ juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
 {
     return new SimpleDelayAudioProcessor();
 }
-
-float SimpleDelayAudioProcessor::getRMSValue(int channel) //get function to provide the rms levels for the editor
-{
-    jassert(channel == 0 || channel == 1);
-    if (channel == 0) {
-        return rmsLevelLeft;
-    }
-    else if (channel == 1) {
-        return rmsLevelRight;
-    }
-    else {
-        return 0.0f;
-    }
-}
-
-float SimpleDelayAudioProcessor::getOutRMSValue(int channel) //same as above
-{
-    jassert(channel == 0 || channel == 1);
-    if (channel == 0) {
-        return rmsOutLevelLeft;
-    }
-    else if (channel == 1) {
-        return rmsOutLevelRight;
-    }
-    else {
-        return 0.0f;
-    }
-}
@@ -9,11 +9,25 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "Saturator.h"
+#include "DelayBuffer.h"
+#include "Profiler.h"
+#include "WorkerPool.h"
+#include "DelayResizeThread.h"
+#include "ToneFilter.h"
+
+//set to 1 to build the processor without its editor, the benchmark console app does
+#ifndef SIMPLEDELAY_HEADLESS
+ #define SIMPLEDELAY_HEADLESS 0
+#endif
 
 //==============================================================================
 /**
 */
-class SimpleDelayAudioProcessor  : public juce::AudioProcessor
+class SimpleDelayAudioProcessor  : public juce::AudioProcessor,
+                                   private DelayResizeThread::Client,
+                                   private juce::AudioProcessorValueTreeState::Listener,
+                                   private juce::AsyncUpdater
                             #if JucePlugin_Enable_ARA
                              , public juce::AudioProcessorARAExtension
                             #endif
@@ -32,8 +46,10 @@ public:
    #endif
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
 
-    void createDelay(int channel, juce::dsp::DelayLine<float, juce::dsp::DelayLineInterpolationTypes::Linear> &delayLine, juce::AudioBuffer<float>& buffer);
+    //the DSP is templated on the sample type, so a double precision host gets its own path with no conversion
+    bool supportsDoublePrecisionProcessing() const override { return true; }
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -58,19 +74,203 @@ public:
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
 
-    float getRMSValue(int channel);
-    float getOutRMSValue(int channel);
+    //linear per-block meter data. Sums of squares rather than RMS so any number of frames can be integrated
+    struct MeterFrame
+    {
+        std::array<float, 2> inSquares{}, outSquares{};
+        std::array<float, 2> inPeak{}, outPeak{};
+        juce::int64 numSamples = 0;
+    };
+
+    static constexpr int meterFifoSize = 512;
+
+    //message thread only, returns the number of frames copied into dest
+    int popMeterFrames(MeterFrame* dest, int maxFrames);
+
+    //how long the delay times have to stay short before the ring gives back the memory it grew for, any thread
+    void setDelayMemoryReleaseTime(double seconds) { delayMemoryReleaseTime = seconds; }
+
+    //Between blocks, on the thread that calls processBlock. True while the times have outgrown the ring and the resize
+    //thread hasn't got a bigger one ready for the next block yet, so a headless render can wait for it.
+    bool isDelayMemoryGrowing() const;
    
+   #if SIMPLEDELAY_ENABLE_PROFILING
+    const Profiler& getProfiler() const { return profiler; }
+   #endif
+
+    //every parameter is saved, numStateParameters has to grow with the layout
+    static constexpr int numStateParameters = 17;
+
     static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
     juce::AudioProcessorValueTreeState apvts{ *this, nullptr, "parameters", createParameterLayout() };
 
 private:
 
-    std::array<juce::dsp::DelayLine<float, juce::dsp::DelayLineInterpolationTypes::Linear>, 2> delayLine;
-    std::array<juce::dsp::IIR::Filter<float>, 2> filters;
-    std::array<juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear>, 2> smoothedDelay;
+    //everything that holds samples, once per precision. prepareToPlay only sizes the one the host is using
+    template <typename SampleType>
+    struct Engine
+    {
+        DelayBuffer<SampleType> delayBuffer;
+
+        //low cut, high cut and tilt on the delayed signal before it is fed back, designed on the message thread, or on
+        //the audio thread of an offline render
+        ToneFilter<SampleType> toneFilter;
+
+        //per channel, index 0 = 2x and 1 = 4x, all prepared up front
+        std::vector<std::array<std::unique_ptr<juce::dsp::Oversampling<SampleType>>, 2>> oversamplers;
+
+        //one per thread that can run the kernel, index 0 is the audio thread. Scratch rows for the block kernel,
+        //scratchRowsPerLine for each channel of a pair: filtered delayed samples, saturator input, feedback gain,
+        //wet gain, dry gain (the gain rows are only filled while ramping). Then from sharedScratchRow: a copy of a
+        //wrapped span for DelayBuffer::read, a temp for the routing mix, and the routed feedback and output pairs
+        std::vector<juce::AudioBuffer<SampleType>> workerScratch;
+
+        //the host buffer of the block being processed, for the workers
+        juce::AudioBuffer<SampleType>* currentBuffer = nullptr;
+    };
+
+    Engine<float> floatEngine;
+    Engine<double> doubleEngine;
+
+    template <typename SampleType>
+    Engine<SampleType>& getEngine()
+    {
+        if constexpr (std::is_same_v<SampleType, double>)
+            return doubleEngine;
+        else
+            return floatEngine;
+    }
+
+    template <typename SampleType>
+    void prepareEngine(Engine<SampleType>& engine, int numChannels, double sampleRate, int samplesPerBlock, int numWorkers);
+
+    //sample rate, low cut, high cut, tilt of the coefficients last handed to the tone filters
+    using ToneSettings = std::tuple<double, float, float, float>;
+    ToneSettings lastToneSettings;
+
+    template <typename SampleType>
+    typename ToneFilter<SampleType>::Coefficients designToneFilter(const ToneSettings& settings) const;
+
+    //the tone parameters ask for a new design when they change rather than being polled. handleAsyncUpdate designs
+    //it on the message thread, or on the audio thread of an offline render, so toneDesignLock keeps them apart
+    void parameterChanged(const juce::String& parameterID, float newValue) override;
+    void handleAsyncUpdate() override;
+    juce::CriticalSection toneDesignLock;
+
+    void resizeDelayBuffers() override;
+
+    //longest delay in samples the audio thread has needed lately, the resize thread sizes the ring to it
+    std::atomic<int> reachableDelay{ 0 };
+    std::atomic<double> delayMemoryReleaseTime{ 30.0 };
+    juce::uint32 oversizedSince = 0;
+
+    //held by whoever resizes or prepares the rings: the resize thread, prepareToPlay, and offline the audio thread
+    juce::CriticalSection resizeLock;
+    juce::SharedResourcePointer<DelayResizeThread> resizeThread;
+
+    template <typename SampleType>
+    void resizeDelayBuffer(DelayBuffer<SampleType>& ring);
+
+    //the longest time either delay can be set to, in samples
+    int getFullRangeDelay(double sampleRate) const;
+
+    static constexpr int scratchRowsPerLine = 5;
+    static constexpr int sharedScratchRow = scratchRowsPerLine * 2;
+    static constexpr int numScratchRows = sharedScratchRow + 6;
 
-    float rmsLevelLeft, rmsLevelRight, rmsOutLevelLeft, rmsOutLevelRight;
+    //one of each per channel, sized in prepareToPlay
+    using Smoothed = juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear>;
+    std::vector<Smoothed> smoothedDelay;
+    std::vector<Smoothed> smoothedFeedback;
+    std::vector<Smoothed> smoothedDryWet;
+
+    //parameter values for each sub-block, read once at the top of processBlock and ramped from the previous block's.
+    //The kernel only reads from here
+    struct ParameterSnapshot
+    {
+        float timeLeft = 50.f, timeRight = 50.f;
+        float feedback = .5f, dryWet = .5f;
+        bool wetAlgo = false;
+        int oversampling = 0;
+        int routing = 0;
+        DelayBufferBase::Interpolation interpolation = DelayBufferBase::Interpolation::linear;
+        double sampleRate = 44100.0;
+    };
+
+    std::vector<ParameterSnapshot> subBlockParams;
+    ParameterSnapshot lastBlockParams;
+
+    //Host blocks are processed in chunks of this many samples, each with its own point on the parameter ramp. The
+    //parameters are only read once per host block, since that is all the host hands over, and the ramp runs from the
+    //last block's values to the new ones across the whole block. So a change lands up to one host block late, and
+    //the ramp is as long as the block: the same automation renders slightly differently at different block sizes.
+    static constexpr int subBlockSize = 32;
+
+    void updateParameters(ParameterSnapshot& params);
+
+    template <typename SampleType>
+    void process(juce::AudioBuffer<SampleType>& buffer);
+
+    template <typename SampleType>
+    void processChannelPair(int pair, int slot);
+
+    template <typename SampleType>
+    void createDelay(int firstChannel, int numLines, bool routed, Engine<SampleType>& engine, juce::AudioBuffer<SampleType>& buffer, int startSample,
+                     int numSamples, const ParameterSnapshot& params, juce::AudioBuffer<SampleType>& kernelScratch);
+
+    //Per channel pair, whether its two channels are a mirrored left/right pair of the layout. Only those are routed,
+    //a centre/LFE or an ambisonic pair always runs as two plain lines. Set in prepareToPlay
+    std::vector<bool> routedPairs;
+
+    Saturator saturator;
+
+    int activeOversampling = -1;
+    int activeInterpolation = -1;
+
+    //last tempo the host reported, kept for blocks where it doesn't say
+    std::atomic<double> hostBpm{ 120.0 };
+
+    std::pair<float, float> getDelayTimes() const;
+
+    //idle bypass: after the input and everything written to the ring have stayed under the threshold for longer
+    //than the ring is long, the state is cleared and blocks are skipped until the input has signal again
+    static constexpr float silenceThreshold = 1.0e-8f;
+    bool asleep = false;
+    int silentSamples = 0;
+
+    template <typename SampleType>
+    bool hasSignal(const juce::AudioBuffer<SampleType>& buffer) const;
+
+    template <typename SampleType>
+    void goToSleep(Engine<SampleType>& engine);
+
+    //audio thread -> editor. When the fifo is full the frame is dropped, the audio thread never blocks
+    juce::AbstractFifo meterFifo{ meterFifoSize };
+    std::array<MeterFrame, meterFifoSize> meterFrames;
+    MeterFrame pendingMeterFrame;
+
+    //filled by createDelay as it reads and writes each channel, reset every block
+    struct ChannelMeter
+    {
+        float inSquares = 0.f, outSquares = 0.f;
+        float inPeak = 0.f, outPeak = 0.f;
+        float delayPeak = 0.f;
+    };
+
+    std::vector<ChannelMeter> channelMeters;
+
+    void pushMeterFrame();
+
+    //"SDst" and the layout version of the binary state
+    static constexpr juce::int32 stateMagic = 0x74734453;
+    static constexpr juce::int32 stateVersion = 2;
+
+    //the parameters in the order the binary state stores them
+    std::array<juce::RangedAudioParameter*, numStateParameters> stateParameters{};
+
+   #if SIMPLEDELAY_ENABLE_PROFILING
+    Profiler profiler;
+   #endif
 
     juce::AudioParameterFloat* freqLeft{ nullptr };
     juce::AudioParameterFloat* freqRight{nullptr};
@@ -78,6 +278,23 @@ private:
     juce::AudioParameterFloat* dryWet{ nullptr };
     juce::AudioParameterBool* link{nullptr};
     juce::AudioParameterBool* wetAlgo{nullptr};
+    juce::AudioParameterChoice* satQuality{nullptr};
+    juce::AudioParameterChoice* oversampling{nullptr};
+    juce::AudioParameterChoice* interpolation{nullptr};
+    juce::AudioParameterBool* sync{nullptr};
+    juce::AudioParameterChoice* divisionLeft{nullptr};
+    juce::AudioParameterChoice* divisionRight{nullptr};
+    juce::AudioParameterBool* parallelChannels{nullptr};
+    juce::AudioParameterFloat* lowCut{nullptr};
+    juce::AudioParameterFloat* highCut{nullptr};
+    juce::AudioParameterFloat* tilt{nullptr};
+    juce::AudioParameterChoice* routing{nullptr};
+
+    //opt-in channel pair threads, only started for layouts with at least minParallelChannels channels.
+    //Declared last so the workers are gone before anything they touch is destroyed.
+    static constexpr int minParallelChannels = 6;
+    static constexpr int maxWorkers = 3;
+    WorkerPool workerPool;
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SimpleDelayAudioProcessor)
 };
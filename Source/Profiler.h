@@ -0,0 +1,159 @@
+/*
+  ==============================================================================
+
+    Profiler.h
+
+    Optional per-block timing of the processBlock stages.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//set to 1 in the Projucer preprocessor definitions to build the instrumentation in
+#ifndef SIMPLEDELAY_ENABLE_PROFILING
+ #define SIMPLEDELAY_ENABLE_PROFILING 0
+#endif
+
+#if SIMPLEDELAY_ENABLE_PROFILING
+
+#if JUCE_INTEL
+ #if JUCE_MSVC
+  #include <intrin.h>
+ #else
+  #include <x86intrin.h>
+ #endif
+#endif
+
+//==============================================================================
+/**
+    Lock-free timing histograms for the audio thread.
+
+    Each stage adds its elapsed ticks into a per-block accumulator, and
+    endBlock() drops every stage's total for that block into a log2 bucket.
+    All storage is fixed size and the counters are relaxed atomics, so the
+    audio thread never allocates or waits and any other thread can read a
+    snapshot at any time. Ticks are CPU cycles on x86 and JUCE's high
+    resolution ticks everywhere else.
+*/
+class Profiler
+{
+public:
+    enum Stage { wholeBlock, metering, delayKernel, filter, numStages };
+
+    static constexpr int numBuckets = 32;
+
+    static juce::uint64 now()
+    {
+       #if JUCE_INTEL
+        return (juce::uint64)__rdtsc();
+       #else
+        return (juce::uint64)juce::Time::getHighResolutionTicks();
+       #endif
+    }
+
+    struct ScopedTimer
+    {
+        ScopedTimer(Profiler& p, Stage s) : profiler(p), stage(s), start(now()) {}
+        ~ScopedTimer() { profiler.blockTicks[stage].fetch_add(now() - start, std::memory_order_relaxed); }
+
+        Profiler& profiler;
+        Stage stage;
+        juce::uint64 start;
+    };
+
+    //times the whole processBlock and closes the block when it goes out of scope
+    struct ScopedBlock
+    {
+        explicit ScopedBlock(Profiler& p) : profiler(p), start(now()) {}
+        ~ScopedBlock()
+        {
+            profiler.blockTicks[wholeBlock].fetch_add(now() - start, std::memory_order_relaxed);
+            profiler.endBlock();
+        }
+
+        Profiler& profiler;
+        juce::uint64 start;
+    };
+
+    //audio thread, once at the end of every processBlock (ScopedBlock does this)
+    void endBlock()
+    {
+        for (int stage = 0; stage < numStages; ++stage)
+        {
+            auto ticks = blockTicks[stage].exchange(0, std::memory_order_relaxed);
+
+            //floor(log2(ticks))
+            int bucket = 0;
+            for (auto t = ticks; t > 1 && bucket < numBuckets - 1; t >>= 1)
+                ++bucket;
+
+            auto& h = histograms[stage];
+
+            h.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+            h.count.fetch_add(1, std::memory_order_relaxed);
+            h.total.fetch_add(ticks, std::memory_order_relaxed);
+
+            if (ticks > h.max.load(std::memory_order_relaxed))
+                h.max.store(ticks, std::memory_order_relaxed);
+        }
+    }
+
+    void reset()
+    {
+        for (auto& h : histograms)
+        {
+            for (auto& b : h.buckets)
+                b.store(0, std::memory_order_relaxed);
+            h.count.store(0, std::memory_order_relaxed);
+            h.total.store(0, std::memory_order_relaxed);
+            h.max.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    //any thread but the audio thread, allocates
+    juce::String toString() const
+    {
+        static const char* names[] = { "block", "metering", "delay kernel", "filter" };
+        juce::String text;
+
+        for (int stage = 0; stage < numStages; ++stage)
+        {
+            auto& h = histograms[stage];
+            auto count = h.count.load(std::memory_order_relaxed);
+            auto mean = count > 0 ? (double)h.total.load(std::memory_order_relaxed) / (double)count : 0.0;
+
+            text << names[stage] << ": " << (juce::int64)count << " blocks, mean " << juce::String(mean, 1)
+                 << " ticks, max " << (juce::int64)h.max.load(std::memory_order_relaxed) << juce::newLine;
+
+            for (int bucket = 0; bucket < numBuckets; ++bucket)
+                if (auto n = h.buckets[bucket].load(std::memory_order_relaxed))
+                    text << "    >= 2^" << bucket << ": " << (juce::int64)n << juce::newLine;
+        }
+
+        return text;
+    }
+
+private:
+    struct Histogram
+    {
+        std::array<std::atomic<juce::uint64>, numBuckets> buckets{};
+        std::atomic<juce::uint64> count{ 0 }, total{ 0 }, max{ 0 };
+    };
+
+    //atomic because channel workers time their stages too, which then add up CPU time rather than wall time
+    std::array<std::atomic<juce::uint64>, numStages> blockTicks{};
+    std::array<Histogram, numStages> histograms;
+};
+
+ #define SIMPLEDELAY_PROFILE(stage) const Profiler::ScopedTimer JUCE_JOIN_MACRO(profileScope_, __LINE__) (profiler, Profiler::stage)
+ #define SIMPLEDELAY_PROFILE_BLOCK() const Profiler::ScopedBlock profileBlock_ (profiler)
+
+#else
+
+ #define SIMPLEDELAY_PROFILE(stage)
+ #define SIMPLEDELAY_PROFILE_BLOCK()
+
+#endif
@@ -0,0 +1,214 @@
+/*
+  ==============================================================================
+
+    Saturator.h
+
+    tanh saturation used by the feedback and output stages of the delay.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#if JUCE_INTEL && (JUCE_64BIT || defined (__SSE2__) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2))
+ #include <emmintrin.h>
+ #define SIMPLEDELAY_SATURATOR_SSE 1
+#elif JUCE_ARM && JUCE_64BIT
+ #include <arm_neon.h>
+ #define SIMPLEDELAY_SATURATOR_NEON 1
+#endif
+
+//==============================================================================
+/**
+    tanh with selectable accuracy, in float or double. The approximations are
+    rational functions evaluated four floats or two doubles at a time with
+    SSE2 or NEON, with a scalar tail. The double path uses the same fits, so
+    it takes about twice as long for High and Fast and gains little: Fast
+    has the same error, High's drops to 2.5e-7, set by where it clamps.
+
+    Max abs error of the float path against a double precision tanh over
+    [-20, 20], and time per sample over 512 sample blocks of noise in
+    [-4, 4], on x86-64 (gcc -O2, SSE2). The saturator command of
+    SimpleDelayBenchmark prints them for both precisions:
+
+        Exact   std::tanh                              1.0e-7    14 ns/sample
+        High    13/6 minimax rational, |x| <= 7.905    3.9e-7    1.2 ns/sample
+        Fast    5/4 Pade approximant, |x| <= 3.46      9.9e-4    0.6 ns/sample
+
+    High sits well below the 24 bit noise floor and is the one to use when
+    the sound must not change. Fast is about -60 dB off at worst, near the knee.
+*/
+class Saturator
+{
+public:
+    enum class Quality { exact, high, fast };
+
+    void setQuality(Quality newQuality) { quality = newQuality; }
+    Quality getQuality() const { return quality; }
+
+    template <typename SampleType>
+    SampleType processSample(SampleType x) const
+    {
+        switch (quality)
+        {
+            case Quality::high:  return high<ScalarOps<SampleType>>(x);
+            case Quality::fast:  return fast<ScalarOps<SampleType>>(x);
+            case Quality::exact:
+            default:             return std::tanh(x);
+        }
+    }
+
+    //in place, samples does not need to be aligned
+    template <typename SampleType>
+    void process(SampleType* samples, int numSamples) const
+    {
+        using Vector = VectorOps<SampleType>;
+        using Scalar = ScalarOps<SampleType>;
+
+        switch (quality)
+        {
+            case Quality::high:  processVectorised<Vector, Scalar, &Saturator::high<Vector>, &Saturator::high<Scalar>>(samples, numSamples); break;
+            case Quality::fast:  processVectorised<Vector, Scalar, &Saturator::fast<Vector>, &Saturator::fast<Scalar>>(samples, numSamples); break;
+            case Quality::exact:
+            default:
+                for (int i = 0; i < numSamples; i++)
+                    samples[i] = std::tanh(samples[i]);
+                break;
+        }
+    }
+
+private:
+    template <typename SampleType>
+    struct ScalarOps
+    {
+        using T = SampleType;
+        using V = SampleType;
+        static constexpr int width = 1;
+        static V load(const T* p) { return *p; }
+        static void store(T* p, V v) { *p = v; }
+        static V dup(T f) { return f; }
+        static V add(V a, V b) { return a + b; }
+        static V mul(V a, V b) { return a * b; }
+        static V div(V a, V b) { return a / b; }
+        static V clamp(V v, T limit) { return juce::jlimit(-limit, limit, v); }
+    };
+
+   #if SIMPLEDELAY_SATURATOR_SSE
+    struct FloatVectorOps
+    {
+        using T = float;
+        using V = __m128;
+        static constexpr int width = 4;
+        static V load(const T* p) { return _mm_loadu_ps(p); }
+        static void store(T* p, V v) { _mm_storeu_ps(p, v); }
+        static V dup(T f) { return _mm_set1_ps(f); }
+        static V add(V a, V b) { return _mm_add_ps(a, b); }
+        static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+        static V div(V a, V b) { return _mm_div_ps(a, b); }
+        static V clamp(V v, T limit) { return _mm_max_ps(_mm_set1_ps(-limit), _mm_min_ps(_mm_set1_ps(limit), v)); }
+    };
+
+    struct DoubleVectorOps
+    {
+        using T = double;
+        using V = __m128d;
+        static constexpr int width = 2;
+        static V load(const T* p) { return _mm_loadu_pd(p); }
+        static void store(T* p, V v) { _mm_storeu_pd(p, v); }
+        static V dup(T f) { return _mm_set1_pd(f); }
+        static V add(V a, V b) { return _mm_add_pd(a, b); }
+        static V mul(V a, V b) { return _mm_mul_pd(a, b); }
+        static V div(V a, V b) { return _mm_div_pd(a, b); }
+        static V clamp(V v, T limit) { return _mm_max_pd(_mm_set1_pd(-limit), _mm_min_pd(_mm_set1_pd(limit), v)); }
+    };
+   #elif SIMPLEDELAY_SATURATOR_NEON
+    struct FloatVectorOps
+    {
+        using T = float;
+        using V = float32x4_t;
+        static constexpr int width = 4;
+        static V load(const T* p) { return vld1q_f32(p); }
+        static void store(T* p, V v) { vst1q_f32(p, v); }
+        static V dup(T f) { return vdupq_n_f32(f); }
+        static V add(V a, V b) { return vaddq_f32(a, b); }
+        static V mul(V a, V b) { return vmulq_f32(a, b); }
+        static V div(V a, V b) { return vdivq_f32(a, b); }
+        static V clamp(V v, T limit) { return vmaxq_f32(vdupq_n_f32(-limit), vminq_f32(vdupq_n_f32(limit), v)); }
+    };
+
+    struct DoubleVectorOps
+    {
+        using T = double;
+        using V = float64x2_t;
+        static constexpr int width = 2;
+        static V load(const T* p) { return vld1q_f64(p); }
+        static void store(T* p, V v) { vst1q_f64(p, v); }
+        static V dup(T f) { return vdupq_n_f64(f); }
+        static V add(V a, V b) { return vaddq_f64(a, b); }
+        static V mul(V a, V b) { return vmulq_f64(a, b); }
+        static V div(V a, V b) { return vdivq_f64(a, b); }
+        static V clamp(V v, T limit) { return vmaxq_f64(vdupq_n_f64(-limit), vminq_f64(vdupq_n_f64(limit), v)); }
+    };
+   #else
+    using FloatVectorOps = ScalarOps<float>;
+    using DoubleVectorOps = ScalarOps<double>;
+   #endif
+
+    template <typename SampleType>
+    using VectorOps = std::conditional_t<std::is_same_v<SampleType, double>, DoubleVectorOps, FloatVectorOps>;
+
+    //Horner step: a * b + c
+    template <typename Ops>
+    static typename Ops::V madd(typename Ops::V a, typename Ops::V b, typename Ops::T c) { return Ops::add(Ops::mul(a, b), Ops::dup(c)); }
+
+    //minimax rational fit, the same one Eigen uses for its fast float tanh
+    template <typename Ops>
+    static typename Ops::V high(typename Ops::V x)
+    {
+        x = Ops::clamp(x, 7.90531110763549805f);
+        auto x2 = Ops::mul(x, x);
+
+        auto p = madd<Ops>(x2, Ops::dup(-2.76076847742355e-16f), 2.00018790482477e-13f);
+        p = madd<Ops>(x2, p, -8.60467152213735e-11f);
+        p = madd<Ops>(x2, p, 5.12229709037114e-08f);
+        p = madd<Ops>(x2, p, 1.48572235717979e-05f);
+        p = madd<Ops>(x2, p, 6.37261928875436e-04f);
+        p = madd<Ops>(x2, p, 4.89352455891786e-03f);
+        p = Ops::mul(x, p);
+
+        auto q = madd<Ops>(x2, Ops::dup(1.19825839466702e-06f), 1.18534705686654e-04f);
+        q = madd<Ops>(x2, q, 2.26843463243900e-03f);
+        q = madd<Ops>(x2, q, 4.89352518554385e-03f);
+
+        return Ops::div(p, q);
+    }
+
+    //x (945 + 105x^2 + x^4) / (945 + 420x^2 + 15x^4), clamped where the error is smallest
+    template <typename Ops>
+    static typename Ops::V fast(typename Ops::V x)
+    {
+        x = Ops::clamp(x, 3.46f);
+        auto x2 = Ops::mul(x, x);
+
+        auto p = Ops::mul(x, madd<Ops>(x2, Ops::add(x2, Ops::dup(105.0f)), 945.0f));
+        auto q = madd<Ops>(x2, madd<Ops>(x2, Ops::dup(15.0f), 420.0f), 945.0f);
+
+        return Ops::div(p, q);
+    }
+
+    template <typename Vector, typename Scalar, typename Vector::V (*vectorFn)(typename Vector::V), typename Scalar::V (*scalarFn)(typename Scalar::V)>
+    static void processVectorised(typename Scalar::T* samples, int numSamples)
+    {
+        int i = 0;
+
+        for (; i <= numSamples - Vector::width; i += Vector::width)
+            Vector::store(samples + i, vectorFn(Vector::load(samples + i)));
+
+        for (; i < numSamples; i++)
+            samples[i] = scalarFn(samples[i]);
+    }
+
+    Quality quality = Quality::exact;
+};
@@ -0,0 +1,189 @@
+/*
+  ==============================================================================
+
+    ToneFilter.h
+
+    Low cut, high cut and tilt in the feedback path of the delay.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    Cascade of up to three biquads (transposed direct form II) shared by
+    every channel, with the state kept per channel.
+
+        stage 0   low cut, first order, the filter the delay always had
+        stage 1   high cut, second order Butterworth, off at the top of its range
+        stage 2   tilt, a high shelf at 1 kHz rebalanced so the lows go down
+                  as much as the highs go up, off at 0 dB
+
+    Coefficients are designed by design() off the audio thread, or on it in
+    an offline render, and handed over through a lock-free triple buffer.
+    Whoever calls publish() has to do it from one thread at a time.
+    publish() never waits for the audio thread and update() never waits
+    for the publisher, and neither allocates. The audio thread picks up the
+    newest set once per block in update(). Stages that are off cost nothing.
+*/
+template <typename SampleType>
+class ToneFilter
+{
+public:
+    static constexpr int numStages = 3;
+
+    struct Biquad
+    {
+        SampleType b0 = 1, b1 = 0, b2 = 0, a1 = 0, a2 = 0;
+        bool active = false;
+    };
+
+    using Coefficients = std::array<Biquad, numStages>;
+
+    //any thread, allocates nothing
+    static Coefficients design(double sampleRate, SampleType lowCut, SampleType highCut, SampleType highCutOff, SampleType tiltDb)
+    {
+        using Pi = juce::MathConstants<SampleType>;
+        Coefficients c;
+
+        //tan() blows up at Nyquist and goes negative past it, which makes the biquads unstable. At 44.1 kHz
+        //the top of the high cut range is above 0.45 fs, so the corners are held just under it
+        auto maxCutoff = static_cast<SampleType>(0.45 * sampleRate);
+        lowCut = juce::jmin(lowCut, maxCutoff);
+
+        //same maths as dsp::IIR::Coefficients::makeFirstOrderHighPass, so the default sound doesn't change
+        {
+            auto n = std::tan(Pi::pi * lowCut / static_cast<SampleType>(sampleRate));
+            auto a0inv = static_cast<SampleType>(1) / (n + 1);
+            c[0] = { a0inv, -a0inv, 0, (n - 1) * a0inv, 0, true };
+        }
+
+        if (highCut < highCutOff) {
+            auto n = 1 / std::tan(Pi::pi * juce::jmin(highCut, maxCutoff) / static_cast<SampleType>(sampleRate));
+            auto invQ = Pi::sqrt2;
+            auto c1 = 1 / (1 + invQ * n + n * n);
+            c[1] = { c1, c1 * 2, c1, c1 * 2 * (1 - n * n), c1 * (1 - invQ * n + n * n), true };
+        }
+
+        if (tiltDb != 0) {
+            //RBJ high shelf with gain A^2, then everything scaled by 1/A so it pivots around 1 kHz
+            auto A = std::sqrt(juce::Decibels::decibelsToGain(tiltDb));
+            auto omega = Pi::twoPi * static_cast<SampleType>(1000) / static_cast<SampleType>(sampleRate);
+            auto coso = std::cos(omega);
+            auto beta = std::sin(omega) * std::sqrt(A) / static_cast<SampleType>(0.7071067811865476);
+            auto aminus1TimesCoso = (A - 1) * coso;
+
+            auto a0inv = 1 / ((A + 1) - aminus1TimesCoso + beta);
+            c[2] = { ((A + 1) + aminus1TimesCoso + beta) * a0inv,
+                     -2 * ((A - 1) + (A + 1) * coso) * a0inv,
+                     ((A + 1) + aminus1TimesCoso - beta) * a0inv,
+                     2 * ((A - 1) - (A + 1) * coso) * a0inv,
+                     ((A + 1) - aminus1TimesCoso - beta) * a0inv,
+                     true };
+        }
+
+        return c;
+    }
+
+    //The most the cascade can boost any frequency by. The low cut and the Butterworth high cut never go above 1,
+    //the tilt lifts one side of 1 kHz by half its dB, towards A at the extremes
+    static SampleType getMaximumGain(SampleType tiltDb)
+    {
+        return juce::Decibels::decibelsToGain(std::abs(tiltDb) / 2);
+    }
+
+    //while the audio thread isn't running
+    void prepare(int newNumChannels, const Coefficients& initial)
+    {
+        numChannels = newNumChannels;
+        state.allocate((size_t)(numChannels * numStages * 2), true);
+
+        for (auto& slot : slots)
+            slot = initial;
+
+        current = initial;
+        back = 0;
+        middle = 1;
+        front = 2;
+    }
+
+    void reset() { state.clear((size_t)(numChannels * numStages * 2)); }
+
+    int getNumChannels() const { return numChannels; }
+
+    //one publishing thread at a time, usually the message thread, the audio thread itself when rendering offline
+    void publish(const Coefficients& newCoefficients)
+    {
+        slots[(size_t)back] = newCoefficients;
+        back = middle.exchange(back | freshBit, std::memory_order_acq_rel) & indexMask;
+    }
+
+    //audio thread, once per block before any channel is processed
+    void update()
+    {
+        if ((middle.load(std::memory_order_relaxed) & freshBit) == 0)
+            return;
+
+        front = middle.exchange(front, std::memory_order_acq_rel) & indexMask;
+        auto& next = slots[(size_t)front];
+
+        //a stage coming back on starts from silence rather than from whatever it held when it went off
+        for (int stage = 0; stage < numStages; stage++)
+            if (next[(size_t)stage].active && ! current[(size_t)stage].active)
+                for (int channel = 0; channel < numChannels; channel++)
+                    std::fill_n(getState(channel, stage), 2, SampleType());
+
+        current = next;
+    }
+
+    void process(int channel, SampleType* samples, int numSamples)
+    {
+        for (int stage = 0; stage < numStages; stage++)
+        {
+            auto& f = current[(size_t)stage];
+            if (! f.active)
+                continue;
+
+            auto* s = getState(channel, stage);
+            auto s1 = s[0], s2 = s[1];
+
+            for (int i = 0; i < numSamples; i++)
+            {
+                auto input = samples[i];
+                auto output = f.b0 * input + s1;
+                s1 = f.b1 * input - f.a1 * output + s2;
+                s2 = f.b2 * input - f.a2 * output;
+                samples[i] = output;
+            }
+
+            s[0] = s1;
+            s[1] = s2;
+        }
+    }
+
+    SampleType processSample(int channel, SampleType sample)
+    {
+        process(channel, &sample, 1);
+        return sample;
+    }
+
+private:
+    SampleType* getState(int channel, int stage) { return state.get() + (size_t)((channel * numStages + stage) * 2); }
+
+    //triple buffer: the publisher owns slots[back], the audio thread slots[front],
+    //and middle holds the third index plus a bit saying it's newer than front
+    static constexpr int freshBit = 4, indexMask = 3;
+
+    std::array<Coefficients, 3> slots;
+    int back = 0, front = 2;
+    std::atomic<int> middle{ 1 };
+
+    //copy of slots[front] the audio thread and the channel workers read from
+    Coefficients current;
+
+    juce::HeapBlock<SampleType> state;
+    int numChannels = 0;
+};
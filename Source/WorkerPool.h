@@ -0,0 +1,192 @@
+/*
+  ==============================================================================
+
+    WorkerPool.h
+
+    Helper threads that share independent jobs with the audio thread.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#if JUCE_INTEL
+ #include <emmintrin.h>
+#endif
+
+#if JUCE_MAC || JUCE_IOS
+ #include <dispatch/dispatch.h>
+#elif JUCE_WINDOWS
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #include <windows.h>
+#else
+ #include <semaphore.h>
+#endif
+
+//==============================================================================
+/**
+    A counting semaphore on the platform's own primitive. post() never takes
+    a lock: it is an atomic increment, plus a system call to wake the thread
+    when one is blocked in wait().
+*/
+class Semaphore
+{
+public:
+   #if JUCE_MAC || JUCE_IOS
+    Semaphore() : semaphore(dispatch_semaphore_create(0)) {}
+    ~Semaphore() { dispatch_release(semaphore); }
+    void post() { dispatch_semaphore_signal(semaphore); }
+    void wait() { dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER); }
+   #elif JUCE_WINDOWS
+    Semaphore() : semaphore(CreateSemaphore(nullptr, 0, LONG_MAX, nullptr)) {}
+    ~Semaphore() { CloseHandle(semaphore); }
+    void post() { ReleaseSemaphore(semaphore, 1, nullptr); }
+    void wait() { WaitForSingleObject(semaphore, INFINITE); }
+   #else
+    Semaphore() { sem_init(&semaphore, 0, 0); }
+    ~Semaphore() { sem_destroy(&semaphore); }
+    void post() { sem_post(&semaphore); }
+    void wait() { while (sem_wait(&semaphore) != 0 && errno == EINTR) {} }
+   #endif
+
+private:
+   #if JUCE_MAC || JUCE_IOS
+    dispatch_semaphore_t semaphore;
+   #elif JUCE_WINDOWS
+    HANDLE semaphore;
+   #else
+    sem_t semaphore;
+   #endif
+
+    JUCE_DECLARE_NON_COPYABLE(Semaphore)
+};
+
+//==============================================================================
+/**
+    A fixed set of worker threads that split a batch of independent items
+    with the audio thread.
+
+    run() publishes a batch and then the audio thread claims items from the
+    same atomic counter as the workers. A worker that is late or asleep only
+    means the audio thread does more of the batch itself, so the audio thread
+    never waits for one to wake up, only for items a worker has already
+    claimed and is running, and it spins with a pause hint while it does.
+    Nothing locks or allocates after prepare().
+
+    Between batches the workers are parked on a semaphore each, so an idle
+    pool uses no CPU. Waking them is a post per worker from the audio
+    thread: no lock, but a system call for each worker that is asleep.
+    They run as realtime threads like the host's audio thread, and are not
+    pinned to cores, the scheduler is free to put them wherever the host's
+    own threads aren't.
+
+    The number of items per batch is fixed in prepare(), which is what keeps
+    a worker that is still leaving the previous batch from claiming an item
+    of the next one.
+*/
+class WorkerPool
+{
+public:
+    //item is the index in the batch, slot is 0 on the audio thread and 1..numWorkers on the workers
+    using Job = std::function<void(int item, int slot)>;
+
+    ~WorkerPool() { stop(); }
+
+    //message thread, while the audio thread isn't running
+    void prepare(int numWorkers, int itemsPerBatch, Job newJob)
+    {
+        stop();
+
+        job = std::move(newJob);
+        numItems = itemsPerBatch;
+        nextItem = itemsPerBatch;
+        itemsDone = itemsPerBatch;
+
+        for (int slot = 1; slot <= numWorkers; slot++)
+            workers.add(new Worker(*this, slot))->startRealtimeThread(juce::Thread::RealtimeOptions{});
+    }
+
+    void stop()
+    {
+        //all of them at once, so they exit in parallel
+        for (auto* worker : workers)
+        {
+            worker->signalThreadShouldExit();
+            worker->wake.post();
+        }
+
+        workers.clear();
+    }
+
+    int getNumWorkers() const { return workers.size(); }
+
+    //audio thread, returns once every item of the batch has run
+    void run()
+    {
+        itemsDone.store(0, std::memory_order_relaxed);
+        nextItem.store(0, std::memory_order_release);
+
+        //wakes the parked workers. One that hasn't gone back to waiting yet finds the count already up
+        for (auto* worker : workers)
+            worker->wake.post();
+
+        work(0);
+
+        //only items that are already running are left
+        while (itemsDone.load(std::memory_order_acquire) < numItems)
+            pause();
+    }
+
+private:
+    //tells the core this is a spin-wait, so it doesn't starve its sibling hyperthread or burn power on it
+    static void pause()
+    {
+       #if JUCE_INTEL
+        _mm_pause();
+       #elif JUCE_ARM && JUCE_MSVC
+        __yield();
+       #elif JUCE_ARM
+        __asm__ __volatile__ ("yield");
+       #endif
+    }
+
+    void work(int slot)
+    {
+        for (int item; (item = nextItem.fetch_add(1, std::memory_order_acq_rel)) < numItems;)
+        {
+            job(item, slot);
+            itemsDone.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+    struct Worker : public juce::Thread
+    {
+        Worker(WorkerPool& p, int s) : juce::Thread("SimpleDelay worker " + juce::String(s)), pool(p), slot(s) {}
+        ~Worker() override { stopThread(1000); }
+
+        void run() override
+        {
+            //the semaphore counts, so a batch published before the worker got here isn't missed
+            while (!threadShouldExit())
+            {
+                wake.wait();
+
+                if (!threadShouldExit())
+                    pool.work(slot);
+            }
+        }
+
+        WorkerPool& pool;
+        const int slot;
+        Semaphore wake;
+    };
+
+    Job job;
+    int numItems = 0;
+    std::atomic<int> nextItem{ 0 }, itemsDone{ 0 };
+    juce::OwnedArray<Worker> workers;
+};